@@ -1,27 +1,49 @@
 #include "ViewerApplication.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/io.hpp>
 
+#include "utils/animations.hpp"
+#include "utils/bounds.hpp"
+#include "utils/bvh.hpp"
 #include "utils/cameras.hpp"
 #include "utils/gltf.hpp"
+#include "utils/gltf_loader.hpp"
 #include "utils/images.hpp"
+#include "utils/job_system.hpp"
+#include "utils/joint_palettes.hpp"
+#include "utils/lod_cache.hpp"
+#include "utils/morph_targets.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/scene_graph.hpp"
+#include "utils/shader_blocks.hpp"
+#include "utils/stream_buffer.hpp"
+#include "utils/texture_streamer.hpp"
 
 #include <stb_image_write.h>
 #include <tiny_gltf.h>
 
 
-bool ViewerApplication::loadGltfFile(tinygltf::Model & model){
+// Size of the chunks used to upload mapped buffers
+static const size_t BUFFER_UPLOAD_CHUNK_SIZE = 64 * 1024 * 1024;
+// Pixels transferred to textures per frame while streaming them
+static const size_t TEXTURE_UPLOAD_FRAME_BUDGET = 8 * 1024 * 1024;
+
+bool ViewerApplication::loadGltfFile(tinygltf::Model & model, GltfBuffers &buffers){
 
-  tinygltf::TinyGLTF loader;
   std::string err;
   std::string warn;
 
-  bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, m_gltfFilePath.string());
-  //bool ret = loader.LoadBinaryFromFile(&model, &err, &warn, argv[1]); // for binary glTF(.glb)
+  // .gltf or .glb, detected from the file content. Images are decoded later
+  // in parallel by an ImageDecoder.
+  bool ret = loadGltf(m_gltfFilePath, model, buffers, err, warn, true);
 
   if (!warn.empty()) {
     std::cerr << "Warn: " << warn << std::endl;
@@ -40,36 +62,104 @@ bool ViewerApplication::loadGltfFile(tinygltf::Model & model){
   return true;
 }
 
-std::vector<GLuint> ViewerApplication::createBufferObjects( const tinygltf::Model &model) {
-    std::vector<GLuint> bufferObjects(model.buffers.size(), 0);
-    glGenBuffers(model.buffers.size(), bufferObjects.data());
-    for (size_t bufferIdx = 0; bufferIdx < bufferObjects.size(); bufferIdx++)
-    {
-      glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[bufferIdx]);
-      glBufferStorage(GL_ARRAY_BUFFER, model.buffers[bufferIdx].data.size(), model.buffers[bufferIdx].data.data(), 0);
+std::vector<ViewerApplication::GpuBufferView> ViewerApplication::uploadBufferViews(
+  const tinygltf::Model &model, const GltfBuffers &buffers,
+  const GeometryBatch &geometryBatch, GpuArena &arena) {
+    // Byte ranges of the buffer views read by the VAOs of primitives that are
+    // not in the batch, relative to their buffer
+    const auto noRange = std::make_pair(std::numeric_limits<size_t>::max(), size_t(0));
+    std::vector<std::pair<size_t, size_t>> ranges(model.bufferViews.size(), noRange);
+    const auto addAccessorRange = [&](int accessorIdx) {
+      const auto &accessor = model.accessors[accessorIdx];
+      if (accessor.bufferView < 0 || accessor.count == 0) {
+        return;
+      }
+      const auto &bufferView = model.bufferViews[accessor.bufferView];
+      const auto elementSize = size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+          tinygltf::GetNumComponentsInType(accessor.type));
+      const auto byteStride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+      const auto begin = bufferView.byteOffset + accessor.byteOffset;
+      const auto end = std::min(begin + byteStride * (accessor.count - 1) + elementSize,
+          buffers.buffers[bufferView.buffer].size);
+      auto &range = ranges[accessor.bufferView];
+      range.first = std::min(range.first, begin);
+      range.second = std::max(range.second, end);
+    };
+    size_t primitiveIdx = 0;
+    for (const auto &mesh : model.meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        if (geometryBatch.primitive(primitiveIdx++).batched) {
+          continue;
+        }
+        for (const auto *name : {"POSITION", "NORMAL", "TEXCOORD_0", "TANGENT", "JOINTS_0", "WEIGHTS_0"}) {
+          const auto it = primitive.attributes.find(name);
+          if (it != end(primitive.attributes)) {
+            addAccessorRange(it->second);
+          }
+        }
+        if (primitive.indices >= 0) {
+          addAccessorRange(primitive.indices);
+        }
+      }
     }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    return bufferObjects;
+
+    // Copies start on 4 bytes boundaries to keep attributes aligned
+    size_t totalSize = 0;
+    for (auto &range : ranges) {
+      if (range.first < range.second) {
+        range.first &= ~size_t(3);
+        totalSize += range.second - range.first + GpuArena::ALIGNMENT;
+      }
+    }
+    arena.reserve(totalSize);
+
+    std::vector<GpuBufferView> gpuBufferViews(model.bufferViews.size());
+    for (size_t bufferViewIdx = 0; bufferViewIdx < ranges.size(); ++bufferViewIdx) {
+      const auto &range = ranges[bufferViewIdx];
+      if (range.first >= range.second) {
+        continue;
+      }
+      const auto &bufferView = model.bufferViews[bufferViewIdx];
+      const auto size = range.second - range.first;
+      const auto allocation = arena.allocate(size);
+      auto &gpuBufferView = gpuBufferViews[bufferViewIdx];
+      gpuBufferView.bufferObject = allocation.bufferObject;
+      gpuBufferView.byteOffset = GLintptr(allocation.offset) -
+          GLintptr(range.first) + GLintptr(bufferView.byteOffset);
+
+      // Mapped buffers are streamed by chunks, dropping each uploaded chunk
+      // from memory, so that the whole file is never resident at once
+      const auto *bytes = buffers.data(bufferView.buffer) + range.first;
+      const auto mappedFileIdx = buffers.bufferFiles[bufferView.buffer];
+      for (size_t offset = 0; offset < size; offset += BUFFER_UPLOAD_CHUNK_SIZE) {
+        const auto chunkSize = std::min(BUFFER_UPLOAD_CHUNK_SIZE, size - offset);
+        arena.upload(allocation, offset, bytes + offset, chunkSize);
+        if (mappedFileIdx >= 0) {
+          buffers.mappedFiles[mappedFileIdx].discard(bytes + offset, chunkSize);
+        }
+      }
+    }
+    return gpuBufferViews;
 }
 
 std::vector<GLuint> ViewerApplication::createVertexArrayObjects( const tinygltf::Model &model,
-  const std::vector<GLuint> &bufferObjects,
+  const std::vector<GpuBufferView> &gpuBufferViews,
+  const GeometryBatch &geometryBatch, GLuint drawIndexBuffer,
   std::vector<VaoRange> &meshIndexToVaoRange) {
     std::vector<GLuint> vertexArrayObjects;
 
-    const GLuint VERTEX_ATTRIB_POSITION_IDX = 0;
-    const GLuint VERTEX_ATTRIB_NORMAL_IDX = 1;
-    const GLuint VERTEX_ATTRIB_TEXCOORD0_IDX = 2;
-    const GLuint VERTEX_ATTRIB_TANGENT_IDX = 3;
-
     for(int meshIdx = 0; meshIdx < model.meshes.size(); meshIdx++ ) {
         const int vaoOffset = vertexArrayObjects.size();
         const int primitiveSizeRange = model.meshes[meshIdx].primitives.size();
         vertexArrayObjects.resize(vaoOffset + primitiveSizeRange);
         meshIndexToVaoRange.push_back(VaoRange{vaoOffset, primitiveSizeRange});
-        glGenVertexArrays(primitiveSizeRange, &vertexArrayObjects[meshIdx]);
+        glGenVertexArrays(primitiveSizeRange, &vertexArrayObjects[vaoOffset]);
 
         for(int primitiveIdx = 0; primitiveIdx < primitiveSizeRange; primitiveIdx++) {
+          // Drawn from the batch VAO, their buffer views may not be uploaded
+          if (geometryBatch.primitive(vaoOffset + primitiveIdx).batched) {
+            continue;
+          }
           glBindVertexArray(vertexArrayObjects[vaoOffset + primitiveIdx]);
           {
             const auto iterator = model.meshes[meshIdx].primitives[primitiveIdx].attributes.find("POSITION");
@@ -77,14 +167,13 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects( const tinygltf:
               const auto accessorIdx = (*iterator).second;
               const auto &accessor = model.accessors[accessorIdx];
               const auto &bufferView = model.bufferViews[accessor.bufferView];
-              const auto bufferIdx = bufferView.buffer;
-
-              const auto bufferObject = bufferObjects[bufferIdx];
+              const auto &gpuBufferView = gpuBufferViews[accessor.bufferView];
+              const auto bufferObject = gpuBufferView.bufferObject;
 
               glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION_IDX);
               glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
 
-              const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+              const auto byteOffset = gpuBufferView.byteOffset + accessor.byteOffset;
               glVertexAttribPointer(VERTEX_ATTRIB_POSITION_IDX, accessor.type, accessor.componentType, GL_FALSE, bufferView.byteStride, (void *)byteOffset);
             }
           }
@@ -94,14 +183,13 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects( const tinygltf:
               const auto accessorIdx = (*iterator).second;
               const auto &accessor = model.accessors[accessorIdx];
               const auto &bufferView = model.bufferViews[accessor.bufferView];
-              const auto bufferIdx = bufferView.buffer;
-
-              const auto bufferObject = bufferObjects[bufferIdx];
+              const auto &gpuBufferView = gpuBufferViews[accessor.bufferView];
+              const auto bufferObject = gpuBufferView.bufferObject;
 
               glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL_IDX);
               glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
 
-              const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+              const auto byteOffset = gpuBufferView.byteOffset + accessor.byteOffset;
               glVertexAttribPointer(VERTEX_ATTRIB_NORMAL_IDX, accessor.type, accessor.componentType, GL_FALSE, bufferView.byteStride, (void *)byteOffset);
             }
           }
@@ -111,14 +199,13 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects( const tinygltf:
               const auto accessorIdx = (*iterator).second;
               const auto &accessor = model.accessors[accessorIdx];
               const auto &bufferView = model.bufferViews[accessor.bufferView];
-              const auto bufferIdx = bufferView.buffer;
-
-              const auto bufferObject = bufferObjects[bufferIdx];
+              const auto &gpuBufferView = gpuBufferViews[accessor.bufferView];
+              const auto bufferObject = gpuBufferView.bufferObject;
 
               glEnableVertexAttribArray(VERTEX_ATTRIB_TEXCOORD0_IDX);
               glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
 
-              const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+              const auto byteOffset = gpuBufferView.byteOffset + accessor.byteOffset;
               glVertexAttribPointer(VERTEX_ATTRIB_TEXCOORD0_IDX, accessor.type, accessor.componentType, GL_FALSE, bufferView.byteStride, (void *)byteOffset);
             }
           }
@@ -128,70 +215,119 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects( const tinygltf:
               const auto accessorIdx = (*iterator).second;
               const auto &accessor = model.accessors[accessorIdx];
               const auto &bufferView = model.bufferViews[accessor.bufferView];
-              const auto bufferIdx = bufferView.buffer;
-
-              const auto bufferObject = bufferObjects[bufferIdx];
+              const auto &gpuBufferView = gpuBufferViews[accessor.bufferView];
+              const auto bufferObject = gpuBufferView.bufferObject;
 
               glEnableVertexAttribArray(VERTEX_ATTRIB_TANGENT_IDX);
               glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
 
-              const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+              const auto byteOffset = gpuBufferView.byteOffset + accessor.byteOffset;
               glVertexAttribPointer(VERTEX_ATTRIB_TANGENT_IDX, accessor.type, accessor.componentType, GL_FALSE, bufferView.byteStride, (void *)byteOffset);
             }
           }
-          if(model.meshes[meshIdx].primitives[primitiveIdx].indices >= 0) {
-            const auto &accessor = model.accessors[model.meshes[meshIdx].primitives[primitiveIdx].indices];
+          {
+            const auto iterator = model.meshes[meshIdx].primitives[primitiveIdx].attributes.find("JOINTS_0");
+            if (iterator != end(model.meshes[meshIdx].primitives[primitiveIdx].attributes)) {
+              const auto accessorIdx = (*iterator).second;
+              const auto &accessor = model.accessors[accessorIdx];
+              const auto &bufferView = model.bufferViews[accessor.bufferView];
+              const auto &gpuBufferView = gpuBufferViews[accessor.bufferView];
+              const auto bufferObject = gpuBufferView.bufferObject;
+
+              glEnableVertexAttribArray(VERTEX_ATTRIB_JOINTS0_IDX);
+              glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
+
+              // Unsigned byte or short joint indices, read as integers
+              const auto byteOffset = gpuBufferView.byteOffset + accessor.byteOffset;
+              glVertexAttribIPointer(VERTEX_ATTRIB_JOINTS0_IDX, accessor.type, accessor.componentType, bufferView.byteStride, (void *)byteOffset);
+            }
+          }
+          {
+            const auto iterator = model.meshes[meshIdx].primitives[primitiveIdx].attributes.find("WEIGHTS_0");
+            if (iterator != end(model.meshes[meshIdx].primitives[primitiveIdx].attributes)) {
+              const auto accessorIdx = (*iterator).second;
+              const auto &accessor = model.accessors[accessorIdx];
               const auto &bufferView = model.bufferViews[accessor.bufferView];
-              const auto bufferIdx = bufferView.buffer;
+              const auto &gpuBufferView = gpuBufferViews[accessor.bufferView];
+              const auto bufferObject = gpuBufferView.bufferObject;
 
-              const auto bufferObject = bufferObjects[bufferIdx];
+              glEnableVertexAttribArray(VERTEX_ATTRIB_WEIGHTS0_IDX);
+              glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
+
+              const auto byteOffset = gpuBufferView.byteOffset + accessor.byteOffset;
+              glVertexAttribPointer(VERTEX_ATTRIB_WEIGHTS0_IDX, accessor.type, accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE, bufferView.byteStride, (void *)byteOffset);
+            }
+          }
+          if(model.meshes[meshIdx].primitives[primitiveIdx].indices >= 0) {
+            const auto &accessor = model.accessors[model.meshes[meshIdx].primitives[primitiveIdx].indices];
+              const auto &gpuBufferView = gpuBufferViews[accessor.bufferView];
+              const auto bufferObject = gpuBufferView.bufferObject;
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObject);
           }
+          // One value per instance: draws select it with their base instance
+          glEnableVertexAttribArray(VERTEX_ATTRIB_DRAW_INDEX_IDX);
+          glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+          glVertexAttribIPointer(VERTEX_ATTRIB_DRAW_INDEX_IDX, 1, GL_UNSIGNED_INT, 0, 0);
+          glVertexAttribDivisor(VERTEX_ATTRIB_DRAW_INDEX_IDX, 1);
         }
     }
     glBindVertexArray(0);
     return vertexArrayObjects;
 }
 
-std::vector<GLuint> ViewerApplication::createTextureObjects(const tinygltf::Model &model) const {
-  std::vector<GLuint> texObjects(model.textures.size());
-  glGenTextures(model.textures.size(), &texObjects[0]);
-  tinygltf::Sampler defaultSampler;
-  defaultSampler.minFilter = GL_LINEAR;
-  defaultSampler.magFilter = GL_LINEAR;
-  defaultSampler.wrapS = GL_REPEAT;
-  defaultSampler.wrapT = GL_REPEAT;
-  defaultSampler.wrapR = GL_REPEAT;
-  for(int textIdx = 0; textIdx < model.textures.size(); ++textIdx) {
-    glBindTexture(GL_TEXTURE_2D, texObjects[textIdx]);
-
-    const auto &texture = model.textures[textIdx];
-    assert(texture.source >= 0);
-    const auto &image = model.images[texture.source];
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0,
-            GL_RGBA, image.pixel_type, image.image.data());
-    const auto &sampler =
-      texture.sampler >= 0 ? model.samplers[texture.sampler] : defaultSampler;
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-      sampler.minFilter != -1 ? sampler.minFilter : GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-      sampler.magFilter != -1 ? sampler.magFilter : GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, sampler.wrapR);
-
-    if (sampler.minFilter == GL_NEAREST_MIPMAP_NEAREST ||
-        sampler.minFilter == GL_NEAREST_MIPMAP_LINEAR ||
-        sampler.minFilter == GL_LINEAR_MIPMAP_NEAREST ||
-        sampler.minFilter == GL_LINEAR_MIPMAP_LINEAR) {
-      glGenerateMipmap(GL_TEXTURE_2D);
-    }
+GLuint ViewerApplication::createDrawIndexBuffer(size_t drawCount)
+{
+  std::vector<GLuint> drawIndices(drawCount);
+  for (size_t drawIdx = 0; drawIdx < drawCount; ++drawIdx) {
+    drawIndices[drawIdx] = GLuint(drawIdx);
+  }
+  GLuint drawIndexBuffer;
+  glGenBuffers(1, &drawIndexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+  // At least one element, for VAOs not drawn
+  drawIndices.resize(std::max(drawCount, size_t(1)));
+  glBufferStorage(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint),
+      drawIndices.data(), 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return drawIndexBuffer;
+}
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+std::vector<DrawItem> ViewerApplication::createPrimitiveDrawItems(
+    const tinygltf::Model &model, const std::vector<GLuint> &vertexArrayObjects,
+    const std::vector<GpuBufferView> &gpuBufferViews,
+    const GeometryBatch &geometryBatch)
+{
+  // Indexed like vertexArrayObjects: primitives of each mesh, in order
+  std::vector<DrawItem> drawItems;
+  drawItems.reserve(vertexArrayObjects.size());
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      DrawItem drawItem;
+      drawItem.vertexArrayObject = vertexArrayObjects[drawItems.size()];
+      drawItem.material = primitive.material;
+      drawItem.mode = primitive.mode;
+      const auto &batchPrimitive = geometryBatch.primitive(drawItems.size());
+      if (batchPrimitive.batched) {
+        drawItem.vertexArrayObject = batchPrimitive.vertexArrayObject;
+        drawItem.count = batchPrimitive.indexCount;
+        drawItem.indexType = GL_UNSIGNED_INT;
+        drawItem.indexByteOffset = batchPrimitive.firstIndex * sizeof(GLuint);
+        drawItem.baseVertex = batchPrimitive.baseVertex;
+        drawItem.multiDraw = true;
+      } else if (primitive.indices >= 0) {
+        const auto &accessor = model.accessors[primitive.indices];
+        drawItem.count = GLsizei(accessor.count);
+        drawItem.indexType = accessor.componentType;
+        drawItem.indexByteOffset =
+            gpuBufferViews[accessor.bufferView].byteOffset + accessor.byteOffset;
+      } else if (!primitive.attributes.empty()) {
+        const auto accessorIdx = (*begin(primitive.attributes)).second;
+        drawItem.count = GLsizei(model.accessors[accessorIdx].count);
+      }
+      drawItems.push_back(drawItem);
+    }
   }
-  return texObjects;
+  return drawItems;
 }
 
 void keyCallback(
@@ -208,55 +344,31 @@ int ViewerApplication::run()
   const auto glslProgram =
       compileProgram({m_ShadersRootPath / m_AppName / m_vertexShader,
           m_ShadersRootPath / m_AppName / m_fragmentShader});
-
-  const auto modelViewProjMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelViewProjMatrix");
-  const auto modelViewMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelViewMatrix");
-  const auto modelMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelMatrix");
-  const auto normalMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uNormalMatrix");
-  const auto lightDirectionLocation =
-      glGetUniformLocation(glslProgram.glId(), "uLightDirection");
-  const auto lightIntensityLocation =
-      glGetUniformLocation(glslProgram.glId(), "uLightIntensity");
-  const auto baseColorTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uBaseColorTexture");
-  const auto baseColorFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uBaseColorFactor");
-  const auto metallicFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uMetallicFactor");
-  const auto roughnessFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uRoughnessFactor");
-  const auto metallicRoughnessTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uMetallicRoughnessTexture");
-  const auto emissiveTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uEmissiveTexture");
-  const auto emissiveFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uEmissiveFactor");
-  const auto occlusionTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uOcclusionTexture");
-  const auto occlusionStrengthLocation =
-      glGetUniformLocation(glslProgram.glId(), "uOcclusionStrength");
-  const auto normalTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uNormalMapTexture");
-  const auto normalScaleLocation =
-      glGetUniformLocation(glslProgram.glId(), "uNormalMapScale");
-  const auto uHasTangent =
-      glGetUniformLocation(glslProgram.glId(), "uHasTangent");
-  const auto uHasNormalMap =
-      glGetUniformLocation(glslProgram.glId(), "uHasNormalMap");
-
+  // Uniforms are in buffers and texture units are set by the shaders, see
+  // shader_blocks.hpp
+  const auto cullProgram =
+      compileProgram({m_ShadersRootPath / m_AppName / "cull_draws.cs.glsl"});
+  const auto uFrustumPlanesLocation = glGetUniformLocation(cullProgram.glId(), "uFrustumPlanes");
+  const auto uDrawCommandCountLocation = glGetUniformLocation(cullProgram.glId(), "uDrawCommandCount");
 
   tinygltf::Model model;
-  if(!loadGltfFile(model)) {
+  GltfBuffers buffers;
+  if(!loadGltfFile(model, buffers)) {
     return EXIT_FAILURE;
   };
 
+  // Images are decoded in parallel while the scene is prepared, and
+  // transferred to textures while rendering
+  TextureStreamer textureStreamer(
+      model, buffers, TEXTURE_UPLOAD_FRAME_BUDGET, m_TextureCacheDirectory);
+
+
+  // Flattened nodes of the scene referenced by the glTF file, with their world
+  // matrices
+  SceneGraph sceneGraph(model, model.defaultScene);
 
   glm::vec3 bboxMin, bboxMax;
-  computeSceneBounds(model, bboxMin, bboxMax);
+  computeSceneBounds(model, buffers, bboxMin, bboxMax);
   const glm::vec3 center = (bboxMax + bboxMin) * 0.5f;
   const glm::vec3 diagonalVector = bboxMax - bboxMin;
   const glm::vec3 up(0, 1, 0);
@@ -265,9 +377,10 @@ int ViewerApplication::run()
   // Build projection matrix
   auto maxDistance = glm::length(diagonalVector);
   maxDistance = maxDistance > 0.f ? maxDistance : 100.f;
+  const auto farDistance = 1.5f * maxDistance;
   const auto projMatrix =
       glm::perspective(70.f, float(m_nWindowWidth) / m_nWindowHeight,
-          0.001f * maxDistance, 1.5f * maxDistance);
+          0.001f * maxDistance, farDistance);
 
   std::unique_ptr<CameraController> cameraController
     = std::make_unique<TrackballCameraController>(m_GLFWHandle.window(), 3.f * maxDistance);
@@ -278,12 +391,146 @@ int ViewerApplication::run()
         Camera{eye, center, up});
   }
 
-  std::vector<GLuint> texObjects = createTextureObjects(model);
+  // A draw per primitive of each node with a mesh, and of each of its
+  // EXT_mesh_gpu_instancing instances
+  std::vector<std::vector<glm::mat4>> nodeInstanceMatrices(sceneGraph.size());
+  size_t drawCount = 0;
+  for(const auto flatIdx : sceneGraph.meshNodes()) {
+    nodeInstanceMatrices[flatIdx] = getNodeInstanceMatrices(model, buffers, model.nodes[sceneGraph.nodeIndex(flatIdx)]);
+    drawCount += model.meshes[sceneGraph.mesh(flatIdx)].primitives.size() *
+        std::max(nodeInstanceMatrices[flatIdx].size(), size_t(1));
+  }
+  const GLuint drawIndexBuffer = createDrawIndexBuffer(drawCount);
+
+  // Levels of detail, animations and transforms are computed in parallel, on
+  // all cores
+  JobSystem jobSystem;
+
+  // Geometry is packed in a few large buffers: primitives with a common vertex
+  // layout are repacked in a batch, drawn by multi-draw indirect calls, and
+  // only the buffer view ranges read by the other primitives are uploaded.
+  // Levels of detail of the batch are simplified once, then read from the
+  // cache.
+  GpuArena geometryArena;
+  const LodCache lodCache(m_LodCacheDirectory);
+  const GeometryBatch geometryBatch(model, buffers, geometryArena, drawIndexBuffer, &lodCache, &jobSystem, m_bOptimizeMeshes, m_bQuantizeVertices);
+  const auto &vertexCacheStats = geometryBatch.vertexCacheStats();
+  const auto &optimizedVertexCacheStats = geometryBatch.optimizedVertexCacheStats();
+  if(vertexCacheStats.triangleCount) {
+    std::cout << "Vertex cache of " << vertexCacheStats.triangleCount << " triangles: ACMR "
+              << vertexCacheStats.acmr() << ", ATVR " << vertexCacheStats.atvr();
+    if(m_bOptimizeMeshes) {
+      std::cout << ", optimized ACMR " << optimizedVertexCacheStats.acmr() << ", ATVR "
+                << optimizedVertexCacheStats.atvr();
+    }
+    std::cout << std::endl;
+  }
+  const std::vector<GpuBufferView> gpuBufferViews = uploadBufferViews(model, buffers, geometryBatch, geometryArena);
+
+  std::vector<VaoRange> meshIndexToVaoRange;
+  std::vector<GLuint> vertexArrayObjects = createVertexArrayObjects(model, gpuBufferViews, geometryBatch, drawIndexBuffer, meshIndexToVaoRange);
+  const std::vector<DrawItem> primitiveDrawItems = createPrimitiveDrawItems(model, vertexArrayObjects, gpuBufferViews, geometryBatch);
+  const MorphTargets morphTargets(model, buffers);
+  RenderQueue renderQueue;
+
+  // Local bounds of the primitives, indexed like vertexArrayObjects, and world
+  // bounds of each draw, updated with world matrices
+  std::vector<Aabb> primitiveBounds;
+  primitiveBounds.reserve(vertexArrayObjects.size());
+  for(const auto &mesh : model.meshes) {
+    for(const auto &primitive : mesh.primitives) {
+      primitiveBounds.push_back(getPrimitiveBounds(model, buffers, primitive));
+    }
+  }
+  std::vector<Aabb> drawBounds(drawCount);
+  // Joint matrices of the skinned nodes, updated with world matrices
+  JointPalettes jointPalettes(model, buffers, sceneGraph);
+  // Node, primitive (index in vertexArrayObjects), instance matrix (applied
+  // before the node matrix) and first joint matrix (-1 if not skinned) of each
+  // draw
+  std::vector<size_t> drawNodes, drawPrimitives;
+  std::vector<glm::mat4> drawInstanceMatrices;
+  std::vector<int32_t> drawJointOffsets;
+  drawNodes.reserve(drawCount);
+  drawPrimitives.reserve(drawCount);
+  drawInstanceMatrices.reserve(drawCount);
+  drawJointOffsets.reserve(drawCount);
+  for(const auto flatIdx : sceneGraph.meshNodes()) {
+    const auto &mesh = model.meshes[sceneGraph.mesh(flatIdx)];
+    const auto &vaoRange = meshIndexToVaoRange[sceneGraph.mesh(flatIdx)];
+    const auto &instanceMatrices = nodeInstanceMatrices[flatIdx];
+    const auto instanceCount = std::max(instanceMatrices.size(), size_t(1));
+    for(size_t instanceIdx = 0; instanceIdx < instanceCount; ++instanceIdx) {
+      for(GLsizei primIdx = 0; primIdx < vaoRange.count; ++primIdx) {
+        drawNodes.push_back(flatIdx);
+        drawPrimitives.push_back(vaoRange.begin + primIdx);
+        drawInstanceMatrices.push_back(instanceMatrices.empty() ? glm::mat4(1) : instanceMatrices[instanceIdx]);
+        const auto &attributes = mesh.primitives[primIdx].attributes;
+        const auto skinned = attributes.count("JOINTS_0") && attributes.count("WEIGHTS_0");
+        drawJointOffsets.push_back(skinned ? jointPalettes.jointOffset(flatIdx) : -1);
+      }
+    }
+  }
+  nodeInstanceMatrices.clear();
+  // Morph target weights of the nodes whose mesh has targets, from the node or
+  // else the mesh. Offsets are indexed by flat node index.
+  std::vector<float> morphWeights;
+  std::vector<uint32_t> nodeMorphWeightOffsets(sceneGraph.size(), 0);
+  for(const auto flatIdx : sceneGraph.meshNodes()) {
+    const auto &mesh = model.meshes[sceneGraph.mesh(flatIdx)];
+    size_t targetCount = 0;
+    for(const auto &primitive : mesh.primitives) {
+      targetCount = std::max(targetCount, primitive.targets.size());
+    }
+    if(!targetCount) {
+      continue;
+    }
+    const auto &node = model.nodes[sceneGraph.nodeIndex(flatIdx)];
+    const auto &weights = node.weights.empty() ? mesh.weights : node.weights;
+    nodeMorphWeightOffsets[flatIdx] = uint32_t(morphWeights.size());
+    for(size_t targetIdx = 0; targetIdx < targetCount; ++targetIdx) {
+      morphWeights.push_back(targetIdx < weights.size() ? float(weights[targetIdx]) : 0.f);
+    }
+  }
+  const auto restMorphWeights = morphWeights;
+
+  // The selected animation sets local matrices and morph weights when its time
+  // changes, world matrices and bounds then follow
+  Animations animations(model, buffers, sceneGraph);
+  int animationIdx = animations.size() ? 0 : -1;
+  bool animationPlaying = true;
+  bool animationLoop = true;
+  float animationSpeed = 1.f;
+  float animationTime = 0.f;
+  bool animationTimeChanged = true;
+
+  // Hierarchy of the world bounds of the draws, built on the first frame and
+  // refitted when world matrices change
+  Bvh sceneBvh;
+  std::vector<uint32_t> visibleDraws;
+  // Draws outside of the view frustum are not submitted. Draws of the geometry
+  // batch can instead be culled on the GPU by cullProgram, which is cheaper for
+  // scenes with many draws.
+  bool frustumCulling = true;
+  bool gpuCulling = false;
+  // Batched triangle draws use the coarsest level of detail whose error, in
+  // pixels once projected at the distance of the draw, is below lodPixelError
+  bool lodSelection = true;
+  float lodPixelError = 1.f;
+  // Meshlets of batched draws at full detail that are out of the frustum, or
+  // back facing if single sided, are skipped on the CPU
+  bool meshletCulling = true;
+  // Draw under the cursor on the last right click
+  int pickedDraw = -1;
+  bool pickButtonPressed = false;
+  //std::cout << vertexArrayObjects.size() << std::endl;
+
+  // Bound in place of textures that are not resident yet
   GLuint whiteTexture;
   float white[] = {1., 1., 1., 1.};
   glGenTextures(1, &whiteTexture);
   glBindTexture(GL_TEXTURE_2D, whiteTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0,
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0,
         GL_RGBA, GL_FLOAT, white);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -293,12 +540,6 @@ int ViewerApplication::run()
 
   glBindTexture(GL_TEXTURE_2D, 0);
 
-  std::vector<GLuint> bufferObjects = createBufferObjects(model);
-
-  std::vector<VaoRange> meshIndexToVaoRange;
-  std::vector<GLuint> vertexArrayObjects = createVertexArrayObjects(model, bufferObjects, meshIndexToVaoRange);
-  //std::cout << vertexArrayObjects.size() << std::endl;
-
   glm::vec3 lightDirection(1.f,1.f,1.f);
   glm::vec3 lightIntensity(1.f,1.f,1.f);
 
@@ -309,107 +550,112 @@ int ViewerApplication::run()
   glEnable(GL_DEPTH_TEST);
   glslProgram.use();
 
-  const auto bindMaterial = [&](const auto materialIndex) {
+  // Per frame uniforms
+  GLuint frameBuffer;
+  glGenBuffers(1, &frameBuffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+  glBufferStorage(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, frameBuffer);
+
+  // Parameters of all materials, indexed by material. They only change when
+  // textures become resident.
+  GLuint materialBuffer;
+  glGenBuffers(1, &materialBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      (model.materials.size() + 1) * sizeof(MaterialBlock), nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BLOCK_BINDING, materialBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MORPH_DELTA_BLOCK_BINDING, morphTargets.bufferObject());
+  size_t materialResidentTextureCount = size_t(-1);
+  const auto updateMaterialBuffer = [&]() {
+    if(textureStreamer.residentTextureCount() == materialResidentTextureCount) {
+      return;
+    }
+    const auto materialBlocks = getMaterialBlocks(model, textureStreamer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+        materialBlocks.size() * sizeof(MaterialBlock), materialBlocks.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    materialResidentTextureCount = textureStreamer.residentTextureCount();
+  };
+
+  // Matrices and material of each draw of a frame, in a ring of buffer
+  // segments indexed by draw index
+  StreamBuffer objectBuffer;
+  // Commands of the multi-draw indirect calls of a frame
+  StreamBuffer drawCommandBuffer;
+  // Morph weights of a frame
+  StreamBuffer morphWeightBuffer;
+  // Joint matrices of all skins of a frame
+  StreamBuffer jointBuffer;
+  // Model and normal matrices of the draws, updated with world matrices
+  std::vector<glm::mat4> drawModelMatrices;
+  std::vector<glm::mat4> drawNormalMatrices;
+  // Draw calls and multi-draw commands of the last frame
+  size_t drawCommandTotal = 0;
+  // Triangles of the draws submitted by the last frame
+  size_t submittedTriangleCount = 0;
+  // Meshlets of the last frame
+  size_t testedMeshletCount = 0;
+  size_t visibleMeshletCount = 0;
+  // Multi-draw commands of a frame, and their count for each item starting a
+  // run of instances
+  std::vector<DrawElementsIndirectCommand> frameDrawCommands;
+  std::vector<uint32_t> itemDrawCommandCounts;
+  std::vector<uint8_t> meshletVisibility;
+
+  // Texture and sampler bound to each of the texture units used by materials,
+  // to skip redundant binds. Reset at the start of each frame since ImGui
+  // binds its own.
+  GLuint boundTextures[MATERIAL_TEXTURE_UNIT_COUNT];
+  GLuint boundSamplers[MATERIAL_TEXTURE_UNIT_COUNT];
+  const auto resetBoundTextures = [&]() {
+    std::fill_n(boundTextures, MATERIAL_TEXTURE_UNIT_COUNT, GLuint(-1));
+    std::fill_n(boundSamplers, MATERIAL_TEXTURE_UNIT_COUNT, GLuint(-1));
+  };
+
+  const auto bindTextureObject =
+      [&](GLuint unit, GLuint textureObject, GLuint samplerObject) {
+        if (boundTextures[unit] != textureObject) {
+          glActiveTexture(GL_TEXTURE0 + unit);
+          glBindTexture(GL_TEXTURE_2D, textureObject);
+          boundTextures[unit] = textureObject;
+        }
+        if (boundSamplers[unit] != samplerObject) {
+          glBindSampler(unit, samplerObject);
+          boundSamplers[unit] = samplerObject;
+        }
+      };
+
+  // Bind a texture with its sampler to a texture unit. Missing textures are
+  // replaced by defaultTexture, textures that are not resident yet by the
+  // white texture.
+  const auto bindTexture = [&](GLuint unit, int textureIdx, GLuint defaultTexture) {
+    const auto textureObject = textureIdx >= 0 ? textureStreamer.textureObject(textureIdx) : 0;
+    if (textureObject) {
+      bindTextureObject(
+          unit, textureObject, textureStreamer.samplerObject(textureIdx));
+    } else {
+      bindTextureObject(unit, textureIdx >= 0 ? whiteTexture : defaultTexture, 0);
+    }
+  };
+
+  // Material parameters are in materialBuffer, only textures are bound
+  const auto bindMaterialTextures = [&](const auto materialIndex) {
     if(materialIndex >= 0) {
       const auto &material = model.materials[materialIndex];
       const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
-      if(pbrMetallicRoughness.baseColorTexture.index >= 0) {
-        const auto &texture = model.textures[pbrMetallicRoughness.baseColorTexture.index];
-        glActiveTexture(GL_TEXTURE0);
-        assert(texture.source >= 0);
-        glBindTexture(GL_TEXTURE_2D, texObjects[texture.source]);
-        glUniform1i(baseColorTextureLocation, 0);
-        glUniform4f(baseColorFactorLocation,
-          (float)pbrMetallicRoughness.baseColorFactor[0],
-          (float)pbrMetallicRoughness.baseColorFactor[1],
-          (float)pbrMetallicRoughness.baseColorFactor[2],
-          (float)pbrMetallicRoughness.baseColorFactor[3]);
-
-      }
-      else {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, whiteTexture);
-        glUniform1i(baseColorTextureLocation, 0);
-        glUniform4f(baseColorFactorLocation,
-          white[0],
-          white[1],
-          white[2],
-          white[3]);
-      }
-      if(pbrMetallicRoughness.metallicRoughnessTexture.index >= 0) {
-        const auto &texture = model.textures[pbrMetallicRoughness.metallicRoughnessTexture.index];
-        glActiveTexture(GL_TEXTURE1);
-        assert(texture.source >= 0);
-        glBindTexture(GL_TEXTURE_2D, texObjects[texture.source]);
-        glUniform1i(metallicRoughnessTextureLocation, 1);
-        glUniform1f(metallicFactorLocation,
-          (float)pbrMetallicRoughness.metallicFactor);
-        glUniform1f(roughnessFactorLocation,
-          (float)pbrMetallicRoughness.roughnessFactor);
-      }
-      else {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(metallicRoughnessTextureLocation, 1);
-        glUniform1f(metallicFactorLocation,
-          0);
-        glUniform1f(roughnessFactorLocation,
-          0);
-      }
-      if(material.emissiveTexture.index >= 0) {
-        const auto &texture = model.textures[material.emissiveTexture.index];
-        glActiveTexture(GL_TEXTURE2);
-        assert(texture.source >= 0);
-        glBindTexture(GL_TEXTURE_2D, texObjects[texture.source]);
-        glUniform1i(emissiveTextureLocation, 2);
-        glUniform3f(emissiveFactorLocation,
-          (float)material.emissiveFactor[0],
-          (float)material.emissiveFactor[1],
-          (float)material.emissiveFactor[2]);
-      }
-      else {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(emissiveTextureLocation, 2);
-        glUniform3f(emissiveFactorLocation,
-          0,
-          0,
-          0);
-      }
-      if(material.occlusionTexture.index >= 0) {
-        const auto &texture = model.textures[material.occlusionTexture.index];
-        glActiveTexture(GL_TEXTURE3);
-        assert(texture.source >= 0);
-        glBindTexture(GL_TEXTURE_2D, texObjects[texture.source]);
-        glUniform1i(occlusionTextureLocation, 3);
-        glUniform1f(occlusionStrengthLocation,
-          (float)material.occlusionTexture.strength);
-      }
-      else {
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(occlusionTextureLocation, 3);
-        glUniform1f(occlusionStrengthLocation,
-          0);
-      }
-      if(material.normalTexture.index >= 0) {
-        const auto &texture = model.textures[material.normalTexture.index];
-        glActiveTexture(GL_TEXTURE4);
-        assert(texture.source >= 0);
-        glBindTexture(GL_TEXTURE_2D, texObjects[texture.source]);
-        glUniform1i(normalTextureLocation, 4);
-        glUniform1f(normalScaleLocation,
-          (float)material.normalTexture.scale);
-        glUniform1i(uHasNormalMap, 1);
-
-      }
-      else {
-        glActiveTexture(GL_TEXTURE4);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(normalTextureLocation, 4);
-        glUniform1f(normalScaleLocation,
-          1);
-        glUniform1i(uHasNormalMap, 0);
+      bindTexture(BASE_COLOR_TEXTURE_UNIT, pbrMetallicRoughness.baseColorTexture.index, whiteTexture);
+      bindTexture(METALLIC_ROUGHNESS_TEXTURE_UNIT, pbrMetallicRoughness.metallicRoughnessTexture.index, 0);
+      bindTexture(EMISSIVE_TEXTURE_UNIT, material.emissiveTexture.index, 0);
+      bindTexture(OCCLUSION_TEXTURE_UNIT, material.occlusionTexture.index, 0);
+      bindTexture(NORMAL_TEXTURE_UNIT, material.normalTexture.index, 0);
+    } else {
+      bindTextureObject(BASE_COLOR_TEXTURE_UNIT, whiteTexture, 0);
+      for(GLuint unit = BASE_COLOR_TEXTURE_UNIT + 1; unit < MATERIAL_TEXTURE_UNIT_COUNT; ++unit) {
+        bindTextureObject(unit, 0, 0);
       }
     }
   };
@@ -421,74 +667,295 @@ int ViewerApplication::run()
 
     const auto viewMatrix = camera.getViewMatrix();
 
-    // The recursive function that should draw a node
-    // We use a std::function because a simple lambda cannot be recursive
-    const std::function<void(int, const glm::mat4 &)> drawNode =
-        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-          tinygltf::Node node = model.nodes[nodeIdx];
-          glm::mat4 modelMatrix = getLocalToWorldMatrix(node, parentMatrix);
+    // World matrices only change if local matrices have been modified
+    const auto firstFrame = drawModelMatrices.empty();
+    if(sceneGraph.updateWorldMatrices(&jobSystem) || firstFrame) {
+      drawModelMatrices.resize(drawCount);
+      drawNormalMatrices.resize(drawCount);
+      jointPalettes.update(sceneGraph);
+      jobSystem.parallelFor(drawCount, 256, [&](size_t begin, size_t end) {
+        for(size_t drawIdx = begin; drawIdx < end; ++drawIdx) {
+          const auto &modelMatrix = drawModelMatrices[drawIdx] =
+              sceneGraph.worldMatrix(drawNodes[drawIdx]) * drawInstanceMatrices[drawIdx];
+          drawNormalMatrices[drawIdx] = glm::transpose(glm::inverse(modelMatrix));
+          const auto &localBounds = primitiveBounds[drawPrimitives[drawIdx]];
+          drawBounds[drawIdx] = drawJointOffsets[drawIdx] >= 0 ?
+              jointPalettes.skinnedBounds(drawNodes[drawIdx], localBounds, modelMatrix) :
+              transformAabb(localBounds, modelMatrix);
+        }
+      });
+      if(firstFrame) {
+        sceneBvh.build(drawBounds);
+      } else {
+        sceneBvh.refit(drawBounds);
+      }
+    }
+    updateMaterialBuffer();
+
+    FrameBlock frameBlock;
+    frameBlock.viewMatrix = viewMatrix;
+    frameBlock.projMatrix = projMatrix;
+    frameBlock.lightIntensity = glm::vec4(lightIntensity, 0.f);
+    if(lightFromCamera) {
+      frameBlock.lightDirection = glm::vec4(0, 0, 1, 0);
+    }
+    else {
+      frameBlock.lightDirection =
+          glm::vec4(glm::normalize(glm::vec3(viewMatrix * glm::vec4(lightDirection, 0.))), 0.f);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frameBlock), &frameBlock);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Select the visible draws, from the hierarchy unless batched draws are
+    // culled on the GPU
+    const Frustum frustum(projMatrix * viewMatrix);
+    visibleDraws.clear();
+    if(frustumCulling && !gpuCulling) {
+      sceneBvh.queryFrustum(frustum, visibleDraws);
+    } else {
+      for(size_t drawIdx = 0; drawIdx < drawCount; ++drawIdx) {
+        const auto &bounds = drawBounds[drawIdx];
+        if(!frustumCulling || primitiveDrawItems[drawPrimitives[drawIdx]].multiDraw ||
+            bounds.isEmpty() || frustum.intersects(bounds)) {
+          visibleDraws.push_back(uint32_t(drawIdx));
+        }
+      }
+    }
 
-          if(lightIntensityLocation >= 0) {
-            glUniform3f(lightIntensityLocation, lightIntensity[0], lightIntensity[1], lightIntensity[2]);
-          }
-          if(lightDirectionLocation >= 0) {
-            if(lightFromCamera) {
-              glUniform3f(lightDirectionLocation, 0, 0, 1);
-            }
-            else {
-              const glm::vec3 normalizedLightDirectionViewSpace =
-                  glm::normalize(glm::vec3(viewMatrix * glm::vec4(lightDirection, 0.)));
-              glUniform3f(lightDirectionLocation,
-                  normalizedLightDirectionViewSpace[0],
-                  normalizedLightDirectionViewSpace[1],
-                  normalizedLightDirectionViewSpace[2]);
-            }
+    // Queue them and sort them by render state
+    renderQueue.clear();
+    submittedTriangleCount = 0;
+    const auto program = glslProgram.glId();
+    // Pixels per world unit at a distance of 1 from the camera
+    const auto pixelsPerUnit = 0.5f * projMatrix[1][1] * m_nWindowHeight;
+    const auto nearDistance = 0.001f * maxDistance;
+    for(const auto drawIdx : visibleDraws) {
+      // Distance of the draw origin to the camera, for front to back order
+      const auto viewDepth = -(viewMatrix * drawModelMatrices[drawIdx][3]).z;
+      const auto depth = viewDepth / farDistance;
+      auto drawItem = primitiveDrawItems[drawPrimitives[drawIdx]];
+      drawItem.program = program;
+      drawItem.node = int(drawNodes[drawIdx]);
+      drawItem.sceneDraw = int(drawIdx);
+      // The error of a level is scaled by the draw matrix, then projected at
+      // the closest point of the draw bounds
+      const auto &lods = geometryBatch.primitive(drawPrimitives[drawIdx]).lods;
+      size_t lodIdx = 0;
+      if(lodSelection && lods.size() > 1) {
+        const auto &bounds = drawBounds[drawIdx];
+        const auto distance = std::max(bounds.isEmpty() ? viewDepth :
+            glm::distance(camera.eye(), glm::clamp(camera.eye(), bounds.min, bounds.max)), nearDistance);
+        const auto &modelMatrix = drawModelMatrices[drawIdx];
+        const auto scale = std::max({glm::length(glm::vec3(modelMatrix[0])),
+            glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))});
+        const auto maxError = lodPixelError * distance / (scale * pixelsPerUnit);
+        while(lodIdx + 1 < lods.size() && lods[lodIdx + 1].error <= maxError) {
+          ++lodIdx;
+        }
+        drawItem.count = lods[lodIdx].indexCount;
+        drawItem.indexByteOffset = lods[lodIdx].firstIndex * sizeof(GLuint);
+      }
+      if(drawItem.mode == GL_TRIANGLES) {
+        submittedTriangleCount += size_t(drawItem.count) / 3;
+      }
+      renderQueue.push(drawItem, RenderQueue::makeKey(program, drawItem.material,
+          drawItem.vertexArrayObject, drawPrimitives[drawIdx] * GeometryBatch::MAX_LOD_COUNT + lodIdx, depth));
+    }
+    renderQueue.sort();
+
+    // Per draw data, indexed by the draw index: the position in the queue.
+    // Instances of a draw read consecutive blocks.
+    auto *objectBlocks = (ObjectBlock *)objectBuffer.beginWrite(
+        renderQueue.size() * sizeof(ObjectBlock));
+    for(size_t itemIdx = 0; itemIdx < renderQueue.size(); ++itemIdx) {
+      const auto &drawItem = renderQueue[itemIdx];
+      auto &objectBlock = objectBlocks[itemIdx];
+      // Quantized positions are dequantized by the model matrix
+      const auto &batchPrimitive = geometryBatch.primitive(drawPrimitives[drawItem.sceneDraw]);
+      objectBlock.modelMatrix = batchPrimitive.quantized ?
+          drawModelMatrices[drawItem.sceneDraw] * batchPrimitive.dequantizationMatrix :
+          drawModelMatrices[drawItem.sceneDraw];
+      objectBlock.normalMatrix = drawNormalMatrices[drawItem.sceneDraw];
+      objectBlock.materialIdx = drawItem.material >= 0 ? uint32_t(drawItem.material) : defaultMaterialIndex(model);
+      const auto &bounds = drawBounds[drawItem.sceneDraw];
+      objectBlock.boundsMin = glm::vec4(bounds.min, 0.f);
+      objectBlock.boundsMax = glm::vec4(bounds.max, 0.f);
+      // Deltas are indexed by gl_VertexID, which includes the base vertex
+      const auto &morphPrimitive = morphTargets.primitive(drawPrimitives[drawItem.sceneDraw]);
+      objectBlock.morphDeltaBase = int32_t(morphPrimitive.firstDelta) -
+          drawItem.baseVertex * int32_t(morphPrimitive.targetCount * MorphTargets::DELTAS_PER_VERTEX);
+      objectBlock.morphTargetCount = morphPrimitive.targetCount;
+      objectBlock.morphWeightOffset = nodeMorphWeightOffsets[drawItem.node];
+      objectBlock.jointOffset = drawJointOffsets[drawItem.sceneDraw];
+    }
+    objectBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, OBJECT_BLOCK_BINDING,
+        renderQueue.size() * sizeof(ObjectBlock));
+
+    // At least one weight, for the binding to be valid
+    const auto morphWeightByteSize = std::max(morphWeights.size(), size_t(1)) * sizeof(float);
+    auto *frameMorphWeights = (float *)morphWeightBuffer.beginWrite(morphWeightByteSize);
+    std::copy(begin(morphWeights), end(morphWeights), frameMorphWeights);
+    morphWeightBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, MORPH_WEIGHT_BLOCK_BINDING, morphWeightByteSize);
+    const auto &jointMatrices = jointPalettes.jointMatrices();
+    const auto jointByteSize = std::max(jointMatrices.size(), size_t(1)) * sizeof(glm::mat4);
+    auto *frameJointMatrices = (glm::mat4 *)jointBuffer.beginWrite(jointByteSize);
+    std::copy(begin(jointMatrices), end(jointMatrices), frameJointMatrices);
+    jointBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, JOINT_BLOCK_BINDING, jointByteSize);
+
+    // Commands of the multi-draw items, in queue order: a command per run of
+    // instances, or per range of visible meshlets of the run, and runs of
+    // items drawn by a single call have consecutive commands
+    frameDrawCommands.clear();
+    itemDrawCommandCounts.assign(renderQueue.size(), 0);
+    testedMeshletCount = visibleMeshletCount = 0;
+    const auto &meshletRanges = geometryBatch.meshletRanges();
+    for(size_t itemIdx = 0; itemIdx < renderQueue.size();) {
+      const auto &drawItem = renderQueue[itemIdx];
+      const auto instanceRunEnd = renderQueue.instanceRunEnd(itemIdx);
+      if(!drawItem.multiDraw) {
+        itemIdx = instanceRunEnd;
+        continue;
+      }
+      DrawElementsIndirectCommand drawCommand;
+      drawCommand.count = GLuint(drawItem.count);
+      drawCommand.instanceCount = GLuint(instanceRunEnd - itemIdx);
+      drawCommand.firstIndex = GLuint(drawItem.indexByteOffset / sizeof(GLuint));
+      drawCommand.baseVertex = drawItem.baseVertex;
+      drawCommand.baseInstance = GLuint(itemIdx);
+      const auto &batchPrimitive = geometryBatch.primitive(drawPrimitives[drawItem.sceneDraw]);
+      if(!meshletCulling || !batchPrimitive.meshletCount || drawCommand.firstIndex != batchPrimitive.firstIndex) {
+        frameDrawCommands.push_back(drawCommand);
+        ++itemDrawCommandCounts[itemIdx];
+        itemIdx = instanceRunEnd;
+        continue;
+      }
+      // Meshlets visible by any instance of the run, tested in the space of
+      // the primitive: planes are transformed by the transposed model matrix
+      meshletVisibility.assign(batchPrimitive.meshletCount, 0);
+      const auto doubleSided = drawItem.material >= 0 && model.materials[drawItem.material].doubleSided;
+      for(auto instanceIdx = itemIdx; instanceIdx < instanceRunEnd; ++instanceIdx) {
+        const auto &modelMatrix = drawModelMatrices[renderQueue[instanceIdx].sceneDraw];
+        glm::vec4 localPlanes[6];
+        for(int planeIdx = 0; planeIdx < 6; ++planeIdx) {
+          localPlanes[planeIdx] = frustumCulling ? glm::transpose(modelMatrix) * frustum.planes[planeIdx] : glm::vec4(0.f, 0.f, 0.f, 1.f);
+          const auto normalLength = glm::length(glm::vec3(localPlanes[planeIdx]));
+          if(normalLength > 0.f) {
+            localPlanes[planeIdx] /= normalLength;
           }
+        }
+        const glm::vec3 localEye = glm::inverse(modelMatrix) * glm::vec4(camera.eye(), 1.f);
+        // Mirroring matrices swap the front and back faces
+        const auto cullBackfacing = !doubleSided && glm::determinant(glm::mat3(modelMatrix)) > 0.f;
+        cullMeshlets(geometryBatch.meshletBounds(), batchPrimitive.firstMeshlet,
+            batchPrimitive.meshletCount, localPlanes, localEye, cullBackfacing,
+            meshletVisibility.data());
+      }
+      // Consecutive visible meshlets are drawn by a single command
+      testedMeshletCount += batchPrimitive.meshletCount;
+      for(size_t meshletIdx = 0; meshletIdx < batchPrimitive.meshletCount;) {
+        if(!meshletVisibility[meshletIdx]) {
+          ++meshletIdx;
+          continue;
+        }
+        drawCommand.firstIndex = meshletRanges[batchPrimitive.firstMeshlet + meshletIdx].firstIndex;
+        drawCommand.count = 0;
+        while(meshletIdx < batchPrimitive.meshletCount && meshletVisibility[meshletIdx]) {
+          drawCommand.count += GLuint(meshletRanges[batchPrimitive.firstMeshlet + meshletIdx].indexCount);
+          ++visibleMeshletCount;
+          ++meshletIdx;
+        }
+        frameDrawCommands.push_back(drawCommand);
+        ++itemDrawCommandCounts[itemIdx];
+      }
+      itemIdx = instanceRunEnd;
+    }
+    auto *drawCommands = (DrawElementsIndirectCommand *)drawCommandBuffer.beginWrite(
+        frameDrawCommands.size() * sizeof(DrawElementsIndirectCommand));
+    std::copy(begin(frameDrawCommands), end(frameDrawCommands), drawCommands);
+    auto drawCommandCount = frameDrawCommands.size();
+    drawCommandTotal = drawCommandCount;
+    if(frustumCulling && gpuCulling && drawCommandCount) {
+      // Zero the instance count of the commands of invisible draws
+      cullProgram.use();
+      glUniform4fv(uFrustumPlanesLocation, 6, glm::value_ptr(frustum.planes[0]));
+      glUniform1ui(uDrawCommandCountLocation, GLuint(drawCommandCount));
+      drawCommandBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, DRAW_COMMAND_BLOCK_BINDING,
+          drawCommandCount * sizeof(DrawElementsIndirectCommand));
+      glDispatchCompute(GLuint((drawCommandCount + 63) / 64), 1, 1);
+      glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    }
 
-          if(node.mesh >= 0){
-            const glm::mat4 modelViewMatrix = viewMatrix * modelMatrix ;
-            const glm::mat4 modelViewProjectionMatrix = projMatrix * modelViewMatrix;
-            const glm::mat4 normalMatrix = glm::transpose(glm::inverse(modelViewMatrix));
-
-            glUniformMatrix4fv(modelViewMatrixLocation, 1, GL_FALSE, value_ptr(modelViewMatrix));
-            glUniformMatrix4fv(modelViewProjMatrixLocation, 1, GL_FALSE, value_ptr(modelViewProjectionMatrix));
-            glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, value_ptr(modelMatrix));
-            glUniformMatrix4fv(normalMatrixLocation, 1, GL_FALSE, value_ptr(normalMatrix));
-
-            const tinygltf::Mesh &mesh = model.meshes[node.mesh];
-            const auto &vaoRangeMesh = meshIndexToVaoRange[node.mesh];
-            for(size_t primIdx = 0; primIdx < mesh.primitives.size(); ++primIdx) {
-              const auto vaoPrimitive = vertexArrayObjects[vaoRangeMesh.begin + primIdx];
-              const auto &currentPrimitive = mesh.primitives[primIdx];
-              bindMaterial(currentPrimitive.material);
-              glBindVertexArray(vaoPrimitive);
-              if(currentPrimitive.indices >= 0) {
-                const auto &accessor = model.accessors[currentPrimitive.indices];
-                const auto &bufferView = model.bufferViews[accessor.bufferView];
-                const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
-                glDrawElements(currentPrimitive.mode, GLsizei(accessor.count),
-                    accessor.componentType, (const GLvoid *)byteOffset);
-              } else {
-                const auto accessorIdx = (*begin(currentPrimitive.attributes)).second;
-                const auto &accessor = model.accessors[accessorIdx];
-                glDrawArrays(currentPrimitive.mode, 0, GLsizei(accessor.count));
-              }
-            }
-          }
-          for(const auto childNode : node.children) {
-            drawNode(childNode, modelMatrix);
+    // Submit, only changing the state that differs from the previous item
+    drawCommandCount = 0;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer.bufferObject());
+    resetBoundTextures();
+    GLuint currentProgram = 0;
+    GLuint currentVertexArrayObject = 0;
+    int currentMaterial = -2; // No material
+    for(size_t itemIdx = 0; itemIdx < renderQueue.size();) {
+      const auto &drawItem = renderQueue[itemIdx];
+      if(drawItem.program != currentProgram) {
+        glUseProgram(drawItem.program);
+        currentProgram = drawItem.program;
+      }
+      if(drawItem.material != currentMaterial) {
+        bindMaterialTextures(drawItem.material);
+        currentMaterial = drawItem.material;
+      }
+      if(drawItem.vertexArrayObject != currentVertexArrayObject) {
+        glBindVertexArray(drawItem.vertexArrayObject);
+        currentVertexArrayObject = drawItem.vertexArrayObject;
+      }
+      // The base instance selects the draw index of the shaders, instances
+      // of a draw read the next ones
+      if(drawItem.multiDraw) {
+        // All following items with the same state in a single call, a
+        // command per run of instances
+        const auto firstCommandIdx = drawCommandCount;
+        while(itemIdx < renderQueue.size()) {
+          const auto &batchItem = renderQueue[itemIdx];
+          if(!batchItem.multiDraw || batchItem.program != drawItem.program ||
+              batchItem.material != drawItem.material ||
+              batchItem.vertexArrayObject != drawItem.vertexArrayObject ||
+              batchItem.mode != drawItem.mode) {
+            break;
           }
-        };
-
-    // Draw the scene referenced by gltf file
-    if (model.defaultScene >= 0) {
-      for(int nodeIdx : model.scenes[model.defaultScene].nodes) {
-        drawNode(model.scenes[model.defaultScene].nodes[nodeIdx], glm::mat4(1));
+          drawCommandCount += itemDrawCommandCounts[itemIdx];
+          itemIdx = renderQueue.instanceRunEnd(itemIdx);
+        }
+        const auto commandByteOffset = drawCommandBuffer.segmentOffset() +
+            firstCommandIdx * sizeof(DrawElementsIndirectCommand);
+        glMultiDrawElementsIndirect(drawItem.mode, GL_UNSIGNED_INT,
+            (const GLvoid *)commandByteOffset,
+            GLsizei(drawCommandCount - firstCommandIdx), 0);
+        continue;
       }
+      const auto instanceRunEnd = renderQueue.instanceRunEnd(itemIdx);
+      const auto instanceCount = GLsizei(instanceRunEnd - itemIdx);
+      if(drawItem.indexType) {
+        glDrawElementsInstancedBaseVertexBaseInstance(drawItem.mode,
+            drawItem.count, drawItem.indexType,
+            (const GLvoid *)drawItem.indexByteOffset, instanceCount,
+            drawItem.baseVertex, GLuint(itemIdx));
+      } else {
+        glDrawArraysInstancedBaseInstance(drawItem.mode, 0, drawItem.count,
+            instanceCount, GLuint(itemIdx));
+      }
+      ++drawCommandTotal;
+      itemIdx = instanceRunEnd;
     }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    drawCommandBuffer.endWrite();
+    morphWeightBuffer.endWrite();
+    jointBuffer.endWrite();
+    glBindVertexArray(0);
+    objectBuffer.endWrite();
   };
 
   if(!m_OutputPath.empty()) {
+    // The image is rendered once: all textures must be there
+    textureStreamer.finish();
     size_t numCoponents = 3;
     std::vector<unsigned char> pixels(numCoponents * m_nWindowWidth * m_nWindowHeight);
     renderToImage(m_nWindowWidth, m_nWindowHeight, numCoponents, pixels.data(), [&]() {
@@ -502,9 +969,39 @@ int ViewerApplication::run()
   }
 
   // Loop until the user closes the window
+  auto previousSeconds = glfwGetTime();
   for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose();
        ++iterationCount) {
     const auto seconds = glfwGetTime();
+    const auto frameDuration = float(seconds - previousSeconds);
+    previousSeconds = seconds;
+
+    // The animation is evaluated by the job system while textures are
+    // streamed, and waited for before drawing
+    JobSystem::Counter animationJobs;
+    if(animationIdx >= 0) {
+      const auto duration = animations.duration(animationIdx);
+      if(animationPlaying) {
+        animationTime += animationSpeed * frameDuration;
+        if(animationLoop && duration > 0.f) {
+          animationTime = std::fmod(animationTime, duration);
+          animationTime += animationTime < 0.f ? duration : 0.f;
+        } else {
+          animationTime = glm::clamp(animationTime, 0.f, duration);
+        }
+        animationTimeChanged = true;
+      }
+      if(animationTimeChanged) {
+        jobSystem.dispatch([&]() {
+          animations.apply(animationIdx, animationTime, sceneGraph, morphWeights, nodeMorphWeightOffsets, &jobSystem);
+        }, animationJobs);
+        animationTimeChanged = false;
+      }
+    }
+
+    textureStreamer.update();
+
+    jobSystem.wait(animationJobs);
 
     const auto camera = cameraController->getCamera();
     drawScene(camera);
@@ -516,6 +1013,77 @@ int ViewerApplication::run()
       ImGui::Begin("GUI");
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
           1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+      if (!textureStreamer.finished()) {
+        ImGui::Text("Loading textures: %zu / %zu",
+            textureStreamer.residentTextureCount(),
+            textureStreamer.textureCount());
+      }
+      ImGui::Text("Geometry: %.1f MiB in %zu buffers (%.1f MiB used)",
+          geometryArena.reservedSize() / (1024. * 1024.),
+          geometryArena.blockCount(),
+          geometryArena.allocatedSize() / (1024. * 1024.));
+      ImGui::Text("Batched vertices: %.1f MiB%s",
+          geometryBatch.vertexByteSize() / (1024. * 1024.),
+          m_bQuantizeVertices ? " (quantized)" : "");
+      if(vertexCacheStats.triangleCount) {
+        ImGui::Text("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+            vertexCacheStats.acmr(), optimizedVertexCacheStats.acmr(),
+            vertexCacheStats.atvr(), optimizedVertexCacheStats.atvr());
+      }
+      if(ImGui::CollapsingHeader("Culling")) {
+        ImGui::Checkbox("Frustum culling", &frustumCulling);
+        ImGui::Checkbox("Cull batched draws on GPU", &gpuCulling);
+        // Draws culled on the GPU are still submitted
+        ImGui::Text("Submitted draws: %zu / %zu", renderQueue.size(), drawCount);
+        // Repeated primitives are drawn as instances of a single command
+        ImGui::Text("Draw calls and commands: %zu", drawCommandTotal);
+        ImGui::Checkbox("Cull meshlets", &meshletCulling);
+        ImGui::Text("Visible meshlets: %zu / %zu", visibleMeshletCount, testedMeshletCount);
+      }
+      if(ImGui::CollapsingHeader("Levels of detail")) {
+        ImGui::Checkbox("Select levels of detail", &lodSelection);
+        ImGui::SliderFloat("Max error (pixels)", &lodPixelError, 0.1f, 10.f, "%.1f", 2.f);
+        ImGui::Text("Submitted triangles: %zu", submittedTriangleCount);
+      }
+      if(ImGui::CollapsingHeader("Picking", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Text("Right click to pick a primitive");
+        if(pickedDraw >= 0) {
+          const auto flatIdx = drawNodes[pickedDraw];
+          const auto nodeIdx = sceneGraph.nodeIndex(flatIdx);
+          const auto meshIdx = sceneGraph.mesh(flatIdx);
+          const auto primIdx = drawPrimitives[pickedDraw] - meshIndexToVaoRange[meshIdx].begin;
+          ImGui::Text("Node %d \"%s\", mesh \"%s\", primitive %zu", nodeIdx,
+              model.nodes[nodeIdx].name.c_str(), model.meshes[meshIdx].name.c_str(), primIdx);
+        }
+      }
+      if(animations.size() && ImGui::CollapsingHeader("Animation", ImGuiTreeNodeFlags_DefaultOpen)) {
+        // Unnamed animations are shown by index, "None" is -1
+        const auto animationName = [&](int idx) {
+          return idx < 0 ? std::string("None") :
+              animations.name(idx).empty() ? "Animation " + std::to_string(idx) : animations.name(idx);
+        };
+        if(ImGui::BeginCombo("Animation", animationName(animationIdx).c_str())) {
+          for(int idx = -1; idx < int(animations.size()); ++idx) {
+            if(ImGui::Selectable(animationName(idx).c_str(), idx == animationIdx) && idx != animationIdx) {
+              animations.reset(sceneGraph);
+              morphWeights = restMorphWeights;
+              animationIdx = idx;
+              animationTime = 0.f;
+              animationTimeChanged = true;
+            }
+          }
+          ImGui::EndCombo();
+        }
+        if(animationIdx >= 0) {
+          ImGui::Checkbox("Play", &animationPlaying);
+          ImGui::SameLine();
+          ImGui::Checkbox("Loop", &animationLoop);
+          ImGui::SliderFloat("Speed", &animationSpeed, -2.f, 2.f);
+          if(ImGui::SliderFloat("Time", &animationTime, 0.f, animations.duration(animationIdx), "%.2f s")) {
+            animationTimeChanged = true;
+          }
+        }
+      }
       if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Text("eye: %.3f %.3f %.3f", camera.eye().x, camera.eye().y,
             camera.eye().z);
@@ -588,6 +1156,22 @@ int ViewerApplication::run()
       cameraController->update(float(ellapsedTime));
     }
 
+    // Pick the closest draw whose bounds are under the cursor, on the segment
+    // between the near and far planes
+    const auto pickButtonDown = glfwGetMouseButton(m_GLFWHandle.window(), GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+    if(pickButtonDown && !pickButtonPressed && !guiHasFocus) {
+      double cursorX, cursorY;
+      glfwGetCursorPos(m_GLFWHandle.window(), &cursorX, &cursorY);
+      const glm::vec2 ndc(2. * cursorX / m_nWindowWidth - 1., 1. - 2. * cursorY / m_nWindowHeight);
+      const auto invViewProjMatrix = glm::inverse(projMatrix * camera.getViewMatrix());
+      const auto nearPoint = invViewProjMatrix * glm::vec4(ndc, -1.f, 1.f);
+      const auto farPoint = invViewProjMatrix * glm::vec4(ndc, 1.f, 1.f);
+      const auto origin = glm::vec3(nearPoint) / nearPoint.w;
+      float distance = 1.f;
+      pickedDraw = sceneBvh.raycast(origin, glm::vec3(farPoint) / farPoint.w - origin, distance);
+    }
+    pickButtonPressed = pickButtonDown;
+
     m_GLFWHandle.swapBuffers(); // Swap front and back buffers
   }
 
@@ -599,15 +1183,20 @@ int ViewerApplication::run()
 ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
     uint32_t height, const fs::path &gltfFile,
     const std::vector<float> &lookatArgs, const std::string &vertexShader,
-    const std::string &fragmentShader, const fs::path &output) :
+    const std::string &fragmentShader, const fs::path &output,
+    bool optimizeMeshes, bool quantizeVertices) :
     m_nWindowWidth(width),
     m_nWindowHeight(height),
     m_AppPath{appPath},
     m_AppName{m_AppPath.stem().string()},
+    m_TextureCacheDirectory{m_AppName + ".texture-cache"},
+    m_LodCacheDirectory{m_AppName + ".lod-cache"},
     m_ImGuiIniFilename{m_AppName + ".imgui.ini"},
     m_ShadersRootPath{m_AppPath.parent_path() / "shaders"},
     m_gltfFilePath{gltfFile},
-    m_OutputPath{output}
+    m_OutputPath{output},
+    m_bOptimizeMeshes{optimizeMeshes},
+    m_bQuantizeVertices{quantizeVertices}
 {
   if (!lookatArgs.empty()) {
     m_hasUserCamera = true;
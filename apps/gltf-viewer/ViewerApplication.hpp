@@ -3,6 +3,10 @@
 #include "utils/GLFWHandle.hpp"
 #include "utils/cameras.hpp"
 #include "utils/filesystem.hpp"
+#include "utils/geometry_batch.hpp"
+#include "utils/gltf.hpp"
+#include "utils/gpu_arena.hpp"
+#include "utils/render_queue.hpp"
 #include "utils/shaders.hpp"
 #include <tiny_gltf.h>
 
@@ -12,11 +16,21 @@ public:
   ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height,
       const fs::path &gltfFile, const std::vector<float> &lookatArgs,
       const std::string &vertexShader, const std::string &fragmentShader,
-      const fs::path &output);
+      const fs::path &output, bool optimizeMeshes = false,
+      bool quantizeVertices = false);
 
   int run();
 
 private:
+  // Where the content of a buffer view is in GL buffers: the accessors of the
+  // view start at byteOffset + accessor.byteOffset in bufferObject. Only the
+  // ranges read by vertex and index accessors are uploaded.
+  struct GpuBufferView
+  {
+    GLuint bufferObject = 0; // 0 if the view is not uploaded
+    GLintptr byteOffset = 0;
+  };
+
   // A range of indices in a vector containing Vertex Array Objects
   struct VaoRange
   {
@@ -40,6 +54,17 @@ private:
 
   fs::path m_OutputPath;
 
+  // Reorder batched triangle lists for the vertex cache, overdraw and vertex
+  // fetches on load
+  bool m_bOptimizeMeshes = false;
+  // Quantize the batched vertices of static primitives on load
+  bool m_bQuantizeVertices = false;
+
+  // Decoded textures of previous runs, next to m_ImGuiIniFilename
+  const fs::path m_TextureCacheDirectory;
+  // Levels of detail of meshes of previous runs
+  const fs::path m_LodCacheDirectory;
+
   // Order is important here, see comment below
   const std::string m_ImGuiIniFilename;
   // Last to be initialized, first to be destroyed:
@@ -58,13 +83,31 @@ private:
     before most of OpenGL function calls.
   */
 
-  bool loadGltfFile(tinygltf::Model & model);
+  bool loadGltfFile(tinygltf::Model & model, GltfBuffers &buffers);
 
-  std::vector<GLuint> createBufferObjects( const tinygltf::Model &model);
+  // Upload the buffer views read by the primitives of the model that are not
+  // in geometryBatch. Returned views are indexed like model.bufferViews.
+  std::vector<GpuBufferView> uploadBufferViews( const tinygltf::Model &model,
+                                                const GltfBuffers &buffers,
+                                                const GeometryBatch &geometryBatch,
+                                                GpuArena &arena);
 
+  // drawIndexBuffer holds the index of each draw, as an instanced attribute
+  // Primitives of geometryBatch get an empty VAO
   std::vector<GLuint> createVertexArrayObjects( const tinygltf::Model &model,
-                                                const std::vector<GLuint> &bufferObjects, 
+                                                const std::vector<GpuBufferView> &gpuBufferViews,
+                                                const GeometryBatch &geometryBatch,
+                                                GLuint drawIndexBuffer,
                                                 std::vector<VaoRange> &meshIndexToVaoRange);
+
+  // Buffer of the integers 0 to drawCount - 1
+  GLuint createDrawIndexBuffer(size_t drawCount);
+
+  // Draw call parameters of each primitive, indexed like vertexArrayObjects.
+  // Primitives of geometryBatch are drawn from it.
+  std::vector<DrawItem> createPrimitiveDrawItems(const tinygltf::Model &model,
+      const std::vector<GLuint> &vertexArrayObjects,
+      const std::vector<GpuBufferView> &gpuBufferViews,
+      const GeometryBatch &geometryBatch);
   
-  std::vector<GLuint> createTextureObjects(const tinygltf::Model &model) const;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ViewerApplication.hpp"
 #include "utils/GLFWHandle.hpp"
+#include "utils/animation_benchmark.hpp"
 #include "utils/filesystem.hpp"
 
 #include <args.hxx>
@@ -43,6 +44,14 @@ int main(int argc, char **argv)
             "Output path to render the image. If specified no window is shown. "
             "Only png is supported.",
             {"o", "output"}};
+        args::Flag optimizeMeshes{parser, "optimize-meshes",
+            "Reorder triangles and vertices of meshes for the vertex cache, "
+            "overdraw and vertex fetches",
+            {"optimize-meshes"}};
+        args::Flag quantizeVertices{parser, "quantize-vertices",
+            "Quantize vertices of meshes without morph targets nor skin, to "
+            "about a third of their size",
+            {"quantize-vertices"}};
         parser.Parse();
 
         std::vector<float> lookatParams;
@@ -64,10 +73,37 @@ int main(int argc, char **argv)
 
         ViewerApplication app{fs::path{argv[0]}, width, height, args::get(file),
             lookatParams, args::get(vertexShader), args::get(fragmentShader),
-            args::get(output)};
+            args::get(output), args::get(optimizeMeshes),
+            args::get(quantizeVertices)};
         returnCode = app.run();
       }};
 
+  args::Command bench{commands, "bench",
+      "Time animations and world matrix updates with 1 to N threads",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> file{
+            parser, "file", "Path to file", args::Options::Required};
+        args::ValueFlag<int32_t> frames{
+            parser, "frames", "Number of frames per thread count", {"frames"}};
+        args::ValueFlag<int32_t> copies{parser, "copies",
+            "Number of copies of the scene, to animate more nodes",
+            {"copies"}};
+        args::ValueFlag<int32_t> threads{parser, "threads",
+            "Maximum number of threads, one per hardware thread by default",
+            {"threads"}};
+        parser.Parse();
+
+        const auto frameCount = frames ? args::get(frames) : 1000;
+        const auto copyCount = copies ? args::get(copies) : 1;
+        const auto threadCount = threads ? args::get(threads) : 0;
+        returnCode = benchmarkAnimations(args::get(file),
+                         size_t(std::max(frameCount, 1)),
+                         size_t(std::max(copyCount, 1)),
+                         size_t(std::max(threadCount, 0)))
+                         ? 0
+                         : 1;
+      }};
+
   try {
     parser.ParseCLI(argc, argv);
   } catch (const args::Completion &e) {
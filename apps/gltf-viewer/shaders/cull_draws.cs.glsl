@@ -0,0 +1,71 @@
+#version 430
+
+// Frustum culling of the multi-draw indirect commands of a frame: the
+// instance count of each command is set to 0 if the world bounds of all its
+// instances are outside of the frustum, and kept otherwise
+
+layout(local_size_x = 64) in;
+
+struct Object
+{
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uint materialIndex;
+    int morphDeltaBase;
+    uint morphTargetCount;
+    uint morphWeightOffset;
+    vec4 boundsMin; // World space, empty (min > max) if unknown
+    vec4 boundsMax;
+    int jointOffset;
+};
+
+layout(std430, binding = 1) readonly buffer Objects
+{
+    Object uObjects[];
+};
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance; // Draw index of the first instance
+};
+
+layout(std430, binding = 3) buffer DrawCommands
+{
+    DrawCommand uDrawCommands[];
+};
+
+uniform vec4 uFrustumPlanes[6]; // World space, normals pointing inside
+uniform uint uDrawCommandCount;
+
+void main()
+{
+    uint commandIndex = gl_GlobalInvocationID.x;
+    if(commandIndex >= uDrawCommandCount) {
+        return;
+    }
+    DrawCommand command = uDrawCommands[commandIndex];
+
+    bool visible = false;
+    for(uint instance = 0u; instance < command.instanceCount && !visible; ++instance) {
+        Object object = uObjects[command.baseInstance + instance];
+        vec3 boundsMin = object.boundsMin.xyz;
+        vec3 boundsMax = object.boundsMax.xyz;
+        visible = true;
+        if(boundsMin.x <= boundsMax.x) {
+            for(int i = 0; i < 6; ++i) {
+                // Corner of the box the furthest along the plane normal
+                vec3 corner = mix(boundsMin, boundsMax, step(0., uFrustumPlanes[i].xyz));
+                if(dot(uFrustumPlanes[i].xyz, corner) + uFrustumPlanes[i].w < 0.) {
+                    visible = false;
+                }
+            }
+        }
+    }
+    if(!visible) {
+        uDrawCommands[commandIndex].instanceCount = 0u;
+    }
+}
@@ -1,16 +1,21 @@
-#version 330
+#version 430
 
 in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
 in vec2 vTexCoords;
 
-uniform vec3 uLightDirection;
-uniform vec3 uLightIntensity;
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec4 uLightDirection; // View space
+    vec4 uLightIntensity;
+};
 
 out vec3 fColor;
 
 void main(){
     vec3 brdf = vec3(1./3.14);
     vec3 viewSpaceNormal = normalize(vViewSpaceNormal);
-    fColor = brdf * uLightIntensity * dot(viewSpaceNormal, uLightDirection);
+    fColor = brdf * uLightIntensity.rgb * dot(viewSpaceNormal, uLightDirection.xyz);
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
-#version 330
+#version 430
 
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
 layout(location = 3) in vec4 aTangent;
+// Index of the draw in the Objects array, an instanced attribute read at the
+// base instance of the draw call: instances of a draw call read the following
+// objects, with their own transforms
+layout(location = 4) in uint aDrawIndex;
+layout(location = 5) in uvec4 aJoints;
+layout(location = 6) in vec4 aWeights;
 
 out vec3 vViewSpacePosition;
 out vec3 vViewSpaceNormal;
@@ -11,31 +17,95 @@ out vec2 vTexCoords;
 out vec3 vViewSpaceTangent;
 out vec3 vViewSpaceBitangent;
 flat out int vHasTangent;
+flat out uint vMaterialIndex;
 
-uniform mat4 uModelViewProjMatrix;
-uniform mat4 uModelViewMatrix;
-uniform mat4 uModelMatrix;
-uniform mat4 uNormalMatrix;
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec4 uLightDirection; // View space
+    vec4 uLightIntensity;
+};
+
+struct Object
+{
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    uint materialIndex;
+    int morphDeltaBase;
+    uint morphTargetCount;
+    uint morphWeightOffset;
+    vec4 boundsMin; // World space, for culling
+    vec4 boundsMax;
+    int jointOffset; // -1 if not skinned
+};
+
+layout(std430, binding = 1) readonly buffer Objects
+{
+    Object uObjects[];
+};
+
+// Position, normal and tangent deltas of each morph target of each vertex
+layout(std430, binding = 4) readonly buffer MorphDeltas
+{
+    vec4 uMorphDeltas[];
+};
+
+layout(std430, binding = 5) readonly buffer MorphWeights
+{
+    float uMorphWeights[];
+};
 
-uniform int uHasNormalMap;// 0 =  No normal map ; 1 = Normal map but no tangent
+// Joint matrices of the skinned nodes, to the local space of the node
+layout(std430, binding = 6) readonly buffer Joints
+{
+    mat4 uJointMatrices[];
+};
 
 void main()
 {
-    vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1.f));
-    vViewSpaceNormal = normalize(vec3(uNormalMatrix * vec4(aNormal, 0.f)));
-    if (uHasNormalMap == 1) {
-        vViewSpaceTangent = normalize(vec3(uModelMatrix * aTangent));
-        vViewSpaceBitangent = cross(vViewSpaceNormal, vViewSpaceTangent) * aTangent.w;
-    } else {
-        vViewSpaceTangent = vec3(0., 0., 0.);
-        vViewSpaceBitangent = vec3(0., 0., 0.);
+    Object object = uObjects[aDrawIndex];
+
+    vec3 position = aPosition;
+    vec3 normal = aNormal;
+    vec3 tangent = aTangent.xyz;
+    for(uint t = 0u; t < object.morphTargetCount; ++t) {
+        float weight = uMorphWeights[object.morphWeightOffset + t];
+        if(weight != 0.) {
+            int delta = object.morphDeltaBase + (gl_VertexID * int(object.morphTargetCount) + int(t)) * 3;
+            position += weight * uMorphDeltas[delta].xyz;
+            normal += weight * uMorphDeltas[delta + 1].xyz;
+            tangent += weight * uMorphDeltas[delta + 2].xyz;
+        }
     }
+
+    // Skinning applies after morphing
+    if(object.jointOffset >= 0) {
+        mat4 skinMatrix =
+            aWeights.x * uJointMatrices[object.jointOffset + int(aJoints.x)] +
+            aWeights.y * uJointMatrices[object.jointOffset + int(aJoints.y)] +
+            aWeights.z * uJointMatrices[object.jointOffset + int(aJoints.z)] +
+            aWeights.w * uJointMatrices[object.jointOffset + int(aJoints.w)];
+        position = vec3(skinMatrix * vec4(position, 1.f));
+        normal = mat3(skinMatrix) * normal;
+        tangent = mat3(skinMatrix) * tangent;
+    }
+
+    mat4 modelViewMatrix = uViewMatrix * object.modelMatrix;
+    // The view matrix is a rigid transform: it is its own inverse transpose
+    mat4 normalMatrix = uViewMatrix * object.normalMatrix;
+
+    vViewSpacePosition = vec3(modelViewMatrix * vec4(position, 1.f));
+    vViewSpaceNormal = normalize(vec3(normalMatrix * vec4(normal, 0.f)));
+    vViewSpaceTangent = normalize(vec3(modelViewMatrix * vec4(tangent, 0.f)));
+    vViewSpaceBitangent = cross(vViewSpaceNormal, vViewSpaceTangent) * aTangent.w;
     if(aTangent.x == 0. && aTangent.y == 0. && aTangent.z == 0.) {
         vHasTangent = 0;
     } else {
         vHasTangent = 1;
     }
+    vMaterialIndex = object.materialIndex;
 
     vTexCoords = aTexCoords;
-    gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1);
-}
\ No newline at end of file
+    gl_Position =  uProjMatrix * vec4(vViewSpacePosition, 1);
+}
@@ -1,4 +1,4 @@
-#version 330
+#version 430
 
 in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
@@ -6,26 +6,37 @@ in vec2 vTexCoords;
 in vec3 vViewSpaceTangent;
 in vec3 vViewSpaceBitangent;
 flat in int vHasTangent; // 0 =  No tangent ; 1 = has tangent
+flat in uint vMaterialIndex;
 
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec4 uLightDirection; // View space
+    vec4 uLightIntensity;
+};
 
-uniform vec3 uLightDirection;
-uniform vec3 uLightIntensity;
-
-uniform sampler2D uBaseColorTexture;
-uniform vec4 uBaseColorFactor;
-
-uniform float uMetallicFactor;
-uniform float uRoughnessFactor;
-uniform sampler2D uMetallicRoughnessTexture;
-
-uniform sampler2D uEmissiveTexture;
-uniform vec3 uEmissiveFactor;
-
-uniform sampler2D uOcclusionTexture;
-uniform float uOcclusionStrength;
+struct Material
+{
+    vec4 baseColorFactor;
+    vec4 emissiveFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    float occlusionStrength;
+    float normalMapScale;
+    int hasNormalMap;
+};
+
+layout(std430, binding = 2) readonly buffer Materials
+{
+    Material uMaterials[];
+};
 
-uniform sampler2D uNormalMapTexture;
-uniform float uNormalMapScale;
+layout(binding = 0) uniform sampler2D uBaseColorTexture;
+layout(binding = 1) uniform sampler2D uMetallicRoughnessTexture;
+layout(binding = 2) uniform sampler2D uEmissiveTexture;
+layout(binding = 3) uniform sampler2D uOcclusionTexture;
+layout(binding = 4) uniform sampler2D uNormalMapTexture;
 
 out vec3 fColor;
 
@@ -48,35 +59,31 @@ vec3 LINEARtoSRGB(vec3 color)
     return pow(color, vec3(INV_GAMMA));
 }
 
-// sRGB to linear approximation
-// see http://chilliant.blogspot.com/2012/08/srgb-approximations-for-hlsl.html
-vec4 SRGBtoLINEAR(vec4 srgbIn)
-{
-    return vec4(pow(srgbIn.xyz, vec3(GAMMA)), srgbIn.w);
-}
-
 void main()
 {
+    Material material = uMaterials[vMaterialIndex];
+
     vec3 N;
-    if(vHasTangent == 1) {
+    if(material.hasNormalMap == 1 && vHasTangent == 1) {
         mat3 TBN = mat3(vViewSpaceTangent, vViewSpaceBitangent, vViewSpaceNormal);
         vec4 normalFromNormalMap = texture(uNormalMapTexture, vTexCoords);
-        N = TBN * normalize(((2.0f * normalFromNormalMap.rgb - 1.0f) * vec3(uNormalMapScale, uNormalMapScale, 1.0f)));
+        N = TBN * normalize(((2.0f * normalFromNormalMap.rgb - 1.0f) * vec3(material.normalMapScale, material.normalMapScale, 1.0f)));
     } else {
         N = normalize(vViewSpaceNormal);
     }
 
-    vec3 L = uLightDirection;
+    vec3 L = uLightDirection.xyz;
     vec3 V = normalize(-vViewSpacePosition);
     vec3 H = normalize(L + V);
 
-    vec4 baseColorFromTexture = SRGBtoLINEAR(texture(uBaseColorTexture, vTexCoords));
-    vec4 baseColor = baseColorFromTexture * uBaseColorFactor;
+    // Base color and emissive textures have sRGB formats, they are read as linear
+    vec4 baseColorFromTexture = texture(uBaseColorTexture, vTexCoords);
+    vec4 baseColor = baseColorFromTexture * material.baseColorFactor;
     vec4 metallicRoughnessFromTexture = texture(uMetallicRoughnessTexture, vTexCoords);
-    float metallic = uMetallicFactor * metallicRoughnessFromTexture.b;
-    float roughness = uRoughnessFactor * metallicRoughnessFromTexture.g;
-    vec4 emissiveFromTexture = SRGBtoLINEAR(texture(uEmissiveTexture, vTexCoords));
-    vec4 emissive = emissiveFromTexture * vec4(uEmissiveFactor, 1);
+    float metallic = material.metallicFactor * metallicRoughnessFromTexture.b;
+    float roughness = material.roughnessFactor * metallicRoughnessFromTexture.g;
+    vec4 emissiveFromTexture = texture(uEmissiveTexture, vTexCoords);
+    vec4 emissive = emissiveFromTexture * vec4(material.emissiveFactor.rgb, 1);
     vec4 occlusionFromTexture = texture(uOcclusionTexture, vTexCoords);
 
     vec3 c_diffuse = mix(baseColor.rgb * (1 - dielectricSpecular.r), black, metallic);
@@ -112,7 +119,7 @@ void main()
     vec3 f_diffuse = (1 - F) * diffuse;
     vec3 f_specular = F * Vis * D;
 
-    fColor = (f_diffuse + f_specular) * uLightIntensity * NdotL + emissive.xyz;
-    fColor = mix(fColor, fColor * occlusionFromTexture.r, uOcclusionStrength);
+    fColor = (f_diffuse + f_specular) * uLightIntensity.rgb * NdotL + emissive.xyz;
+    fColor = mix(fColor, fColor * occlusionFromTexture.r, material.occlusionStrength);
     fColor = LINEARtoSRGB(fColor);
 }
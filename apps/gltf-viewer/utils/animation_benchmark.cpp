@@ -0,0 +1,124 @@
+#include "animation_benchmark.hpp"
+#include "animations.hpp"
+#include "gltf_loader.hpp"
+#include "job_system.hpp"
+#include "scene_graph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// Append copyCount - 1 copies of the nodes of the model to the default scene,
+// and of the animation channels targeting them
+static void copyScene(tinygltf::Model &model, size_t copyCount)
+{
+  const auto nodeCount = int(model.nodes.size());
+  auto &scene = model.scenes[model.defaultScene];
+  const auto rootNodes = scene.nodes;
+  std::vector<size_t> channelCounts;
+  for (const auto &animation : model.animations) {
+    channelCounts.push_back(animation.channels.size());
+  }
+  for (size_t copyIdx = 1; copyIdx < copyCount; ++copyIdx) {
+    const auto offset = int(copyIdx) * nodeCount;
+    for (int nodeIdx = 0; nodeIdx < nodeCount; ++nodeIdx) {
+      auto node = model.nodes[nodeIdx];
+      for (auto &child : node.children) {
+        child += offset;
+      }
+      model.nodes.push_back(std::move(node));
+    }
+    for (const auto rootNodeIdx : rootNodes) {
+      scene.nodes.push_back(rootNodeIdx + offset);
+    }
+    for (size_t animationIdx = 0; animationIdx < model.animations.size();
+         ++animationIdx) {
+      auto &animation = model.animations[animationIdx];
+      for (size_t channelIdx = 0; channelIdx < channelCounts[animationIdx];
+           ++channelIdx) {
+        auto channel = animation.channels[channelIdx];
+        channel.target_node += offset;
+        animation.channels.push_back(channel);
+      }
+    }
+  }
+}
+
+bool benchmarkAnimations(const fs::path &path, size_t frameCount,
+    size_t copyCount, size_t maxThreadCount)
+{
+  tinygltf::Model model;
+  GltfBuffers buffers;
+  std::string err;
+  std::string warn;
+  if (!loadGltf(path, model, buffers, err, warn, true)) {
+    std::cerr << "Err: " << err << std::endl;
+    return false;
+  }
+  if (model.defaultScene < 0) {
+    model.defaultScene = model.scenes.empty() ? -1 : 0;
+  }
+  if (model.defaultScene < 0 || model.animations.empty()) {
+    std::cerr << "Err: " << path << " has no scene or no animation"
+              << std::endl;
+    return false;
+  }
+  copyScene(model, std::max(copyCount, size_t(1)));
+
+  SceneGraph sceneGraph(model, model.defaultScene);
+  Animations animations(model, buffers, sceneGraph);
+  // Weights are not read, but written by weights channels
+  std::vector<float> morphWeights;
+  std::vector<uint32_t> morphWeightOffsets(sceneGraph.size(), 0);
+  for (const auto flatIdx : sceneGraph.meshNodes()) {
+    size_t targetCount = 0;
+    for (const auto &primitive :
+        model.meshes[sceneGraph.mesh(flatIdx)].primitives) {
+      targetCount = std::max(targetCount, primitive.targets.size());
+    }
+    morphWeightOffsets[flatIdx] = uint32_t(morphWeights.size());
+    morphWeights.resize(morphWeights.size() + targetCount);
+  }
+  size_t channelCount = 0;
+  for (const auto &animation : model.animations) {
+    channelCount += animation.channels.size();
+  }
+  std::cout << sceneGraph.size() << " nodes, " << animations.size()
+            << " animations, " << channelCount << " channels, " << frameCount
+            << " frames" << std::endl;
+
+  if (maxThreadCount == 0) {
+    maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  double singleThreadTime = 0.;
+  for (size_t threadCount = 1; threadCount <= maxThreadCount; ++threadCount) {
+    JobSystem jobSystem(threadCount);
+    animations.reset(sceneGraph);
+    sceneGraph.updateWorldMatrices();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t frameIdx = 0; frameIdx < frameCount; ++frameIdx) {
+      const auto time = float(frameIdx) / 60.f;
+      for (size_t animationIdx = 0; animationIdx < animations.size();
+           ++animationIdx) {
+        const auto duration = animations.duration(animationIdx);
+        animations.apply(animationIdx,
+            duration > 0.f ? std::fmod(time, duration) : 0.f, sceneGraph,
+            morphWeights, morphWeightOffsets, &jobSystem);
+      }
+      sceneGraph.updateWorldMatrices(&jobSystem);
+    }
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const auto frameTime =
+        elapsed.count() / double(std::max(frameCount, size_t(1)));
+    if (threadCount == 1) {
+      singleThreadTime = frameTime;
+    }
+    std::cout << threadCount << " threads: " << frameTime << " ms/frame, x"
+              << singleThreadTime / frameTime << std::endl;
+  }
+  return true;
+}
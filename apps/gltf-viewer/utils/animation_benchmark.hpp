@@ -0,0 +1,14 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+
+// Time the evaluation of all the animations of a glTF file and the update of
+// the world matrices of its default scene, for 1 to maxThreadCount threads of
+// a JobSystem (0: one per hardware thread), and print the time per frame.
+// The scene is copied copyCount times, with its animations, to get a large
+// number of animated nodes from a small file. Return false if the file cannot
+// be loaded.
+bool benchmarkAnimations(const fs::path &path, size_t frameCount,
+    size_t copyCount, size_t maxThreadCount);
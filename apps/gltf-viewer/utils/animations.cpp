@@ -0,0 +1,309 @@
+#include "animations.hpp"
+#include "job_system.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+// Append the elements of an accessor to out as floats, false if it is invalid
+template <typename T>
+static bool appendAccessor(const tinygltf::Model &model,
+    const GltfBuffers &buffers, int accessorIdx, std::vector<float> &out)
+{
+  if (accessorIdx < 0 || size_t(accessorIdx) >= model.accessors.size()) {
+    return false;
+  }
+  const AccessorView<T> view(model, buffers, model.accessors[accessorIdx]);
+  if (!view.valid() || !view.size()) {
+    return false;
+  }
+  const auto first = out.size();
+  out.resize(first + view.size() * AccessorView<T>::componentCount);
+  view.decode(reinterpret_cast<T *>(out.data() + first));
+  return true;
+}
+
+Animations::Animations(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const SceneGraph &sceneGraph)
+{
+  // Rest transforms. Animated nodes have no matrix, the others are never
+  // written.
+  for (size_t flatIdx = 0; flatIdx < sceneGraph.size(); ++flatIdx) {
+    const auto &node = model.nodes[sceneGraph.nodeIndex(flatIdx)];
+    const auto &t = node.translation;
+    const auto &r = node.rotation;
+    const auto &s = node.scale;
+    m_RestTranslations.push_back(
+        t.size() == 3 ? glm::vec3(t[0], t[1], t[2]) : glm::vec3(0.f));
+    m_RestRotations.push_back(r.size() == 4
+                                  ? glm::quat(float(r[3]), float(r[0]),
+                                        float(r[1]), float(r[2]))
+                                  : glm::quat(1.f, 0.f, 0.f, 0.f));
+    m_RestScales.push_back(
+        s.size() == 3 ? glm::vec3(s[0], s[1], s[2]) : glm::vec3(1.f));
+  }
+  m_Translations = m_RestTranslations;
+  m_Rotations = m_RestRotations;
+  m_Scales = m_RestScales;
+  m_LocalMatrices.resize(sceneGraph.size());
+
+  for (const auto &gltfAnimation : model.animations) {
+    Animation animation;
+    animation.name = gltfAnimation.name;
+    for (const auto &gltfSampler : gltfAnimation.samplers) {
+      Sampler sampler;
+      sampler.interpolation =
+          gltfSampler.interpolation == "STEP"
+              ? Interpolation::Step
+              : gltfSampler.interpolation == "CUBICSPLINE"
+                    ? Interpolation::CubicSpline
+                    : Interpolation::Linear;
+      sampler.firstTime = uint32_t(m_Times.size());
+      sampler.firstValue = uint32_t(m_Values.size());
+      sampler.keyCount = 0;
+      sampler.componentCount = 0;
+      // Outputs are vectors for TRS and scalars for weights, several per key
+      const auto componentCount =
+          gltfSampler.output >= 0 &&
+                  size_t(gltfSampler.output) < model.accessors.size()
+              ? tinygltf::GetNumComponentsInType(
+                    model.accessors[gltfSampler.output].type)
+              : 0;
+      bool valid =
+          appendAccessor<float>(model, buffers, gltfSampler.input, m_Times);
+      switch (componentCount) {
+      case 1:
+        valid = valid && appendAccessor<float>(
+                             model, buffers, gltfSampler.output, m_Values);
+        break;
+      case 3:
+        valid = valid && appendAccessor<glm::vec3>(
+                             model, buffers, gltfSampler.output, m_Values);
+        break;
+      case 4:
+        valid = valid && appendAccessor<glm::vec4>(
+                             model, buffers, gltfSampler.output, m_Values);
+        break;
+      default:
+        valid = false;
+      }
+      const auto keyCount = m_Times.size() - sampler.firstTime;
+      const auto valuesPerKey =
+          sampler.interpolation == Interpolation::CubicSpline ? 3 : 1;
+      const auto valueCount = m_Values.size() - sampler.firstValue;
+      if (valid && valueCount % (keyCount * valuesPerKey) == 0) {
+        sampler.keyCount = uint32_t(keyCount);
+        sampler.componentCount =
+            uint32_t(valueCount / (keyCount * valuesPerKey));
+        animation.duration = std::max(animation.duration, m_Times.back());
+      } else {
+        std::cerr << "Warn: invalid sampler in animation \""
+                  << gltfAnimation.name << "\", ignored" << std::endl;
+        m_Times.resize(sampler.firstTime);
+        m_Values.resize(sampler.firstValue);
+      }
+      animation.samplers.push_back(sampler);
+    }
+
+    for (const auto &gltfChannel : gltfAnimation.channels) {
+      const auto &target = gltfChannel.target_node;
+      if (gltfChannel.sampler < 0 ||
+          size_t(gltfChannel.sampler) >= animation.samplers.size() ||
+          target < 0 || size_t(target) >= model.nodes.size()) {
+        continue;
+      }
+      const auto &sampler = animation.samplers[gltfChannel.sampler];
+      const auto flatIdx = sceneGraph.flatIndex(target);
+      if (!sampler.keyCount || flatIdx < 0) {
+        continue;
+      }
+      const auto &node = model.nodes[target];
+      const auto &path = gltfChannel.target_path;
+      if (path != "weights" && !node.matrix.empty()) {
+        std::cerr << "Warn: animated node " << target
+                  << " has a matrix, channel ignored" << std::endl;
+        continue;
+      }
+      const Channel channel{
+          uint32_t(gltfChannel.sampler), uint32_t(flatIdx), 0};
+      if (path == "translation" && sampler.componentCount == 3) {
+        animation.translations.push_back(channel);
+      } else if (path == "rotation" && sampler.componentCount == 4) {
+        animation.rotations.push_back(channel);
+      } else if (path == "scale" && sampler.componentCount == 3) {
+        animation.scales.push_back(channel);
+      } else if (path == "weights" && node.mesh >= 0) {
+        // One key has the weights of all targets
+        size_t targetCount = 0;
+        for (const auto &primitive : model.meshes[node.mesh].primitives) {
+          targetCount = std::max(targetCount, primitive.targets.size());
+        }
+        const auto weightCount = sampler.componentCount;
+        if (targetCount != weightCount) {
+          std::cerr << "Warn: weights channel of node " << target << " has "
+                    << weightCount << " weights for " << targetCount
+                    << " targets, ignored" << std::endl;
+          continue;
+        }
+        animation.weights.push_back(channel);
+        continue;
+      } else {
+        std::cerr << "Warn: unsupported channel \"" << path << "\" of node "
+                  << target << ", ignored" << std::endl;
+        continue;
+      }
+      animation.nodes.push_back(uint32_t(flatIdx));
+    }
+    std::sort(begin(animation.nodes), end(animation.nodes));
+    animation.nodes.erase(
+        std::unique(begin(animation.nodes), end(animation.nodes)),
+        end(animation.nodes));
+    m_Animations.push_back(std::move(animation));
+  }
+}
+
+void Animations::sample(const Sampler &sampler, uint32_t &cursor,
+    float time, bool rotation, float *out) const
+{
+  const auto *times = m_Times.data() + sampler.firstTime;
+  const auto *values = m_Values.data() + sampler.firstValue;
+  const auto keyCount = sampler.keyCount;
+  const auto componentCount = sampler.componentCount;
+
+  // Last key with a time lower or equal to time, 0 before the first one
+  auto key = std::min(cursor, keyCount - 1);
+  if (time < times[key]) {
+    const auto next = uint32_t(
+        std::upper_bound(times, times + keyCount, time) - times);
+    key = next ? next - 1 : 0;
+  } else {
+    while (key + 1 < keyCount && times[key + 1] <= time) {
+      ++key;
+    }
+  }
+  cursor = key;
+
+  // A key of a cubic spline sampler is an in-tangent, a value and an
+  // out-tangent
+  const auto cubic = sampler.interpolation == Interpolation::CubicSpline;
+  const auto keyStride = componentCount * (cubic ? 3 : 1);
+  const auto *value0 = values + key * keyStride + (cubic ? componentCount : 0);
+  if (key + 1 >= keyCount || time <= times[key] ||
+      sampler.interpolation == Interpolation::Step) {
+    std::copy(value0, value0 + componentCount, out);
+    return;
+  }
+
+  const auto keyDelta = times[key + 1] - times[key];
+  const auto t = (time - times[key]) / keyDelta;
+  const auto *value1 = value0 + keyStride;
+  if (!cubic) {
+    if (rotation) {
+      const auto q = glm::slerp(
+          glm::quat(value0[3], value0[0], value0[1], value0[2]),
+          glm::quat(value1[3], value1[0], value1[1], value1[2]), t);
+      out[0] = q.x;
+      out[1] = q.y;
+      out[2] = q.z;
+      out[3] = q.w;
+      return;
+    }
+    for (uint32_t c = 0; c < componentCount; ++c) {
+      out[c] = value0[c] + t * (value1[c] - value0[c]);
+    }
+    return;
+  }
+
+  // Hermite spline, between the out-tangent of key and the in-tangent of the
+  // next key, scaled by the duration between them
+  const auto *outTangent0 = value0 + componentCount;
+  const auto *inTangent1 = value1 - componentCount;
+  const auto t2 = t * t;
+  const auto t3 = t2 * t;
+  const auto h00 = 2.f * t3 - 3.f * t2 + 1.f;
+  const auto h10 = (t3 - 2.f * t2 + t) * keyDelta;
+  const auto h01 = -2.f * t3 + 3.f * t2;
+  const auto h11 = (t3 - t2) * keyDelta;
+  for (uint32_t c = 0; c < componentCount; ++c) {
+    out[c] = h00 * value0[c] + h10 * outTangent0[c] + h01 * value1[c] +
+             h11 * inTangent1[c];
+  }
+}
+
+glm::mat4 Animations::localMatrix(size_t flatIdx) const
+{
+  // Same as getLocalToWorldMatrix
+  const auto T = glm::translate(glm::mat4(1), m_Translations[flatIdx]);
+  const auto TR = T * glm::mat4_cast(m_Rotations[flatIdx]);
+  return glm::scale(TR, m_Scales[flatIdx]);
+}
+
+void Animations::apply(size_t animationIdx, float time,
+    SceneGraph &sceneGraph, std::vector<float> &morphWeights,
+    const std::vector<uint32_t> &morphWeightOffsets, JobSystem *jobSystem)
+{
+  // Channels and nodes per job
+  static const size_t grainSize = 64;
+  const auto forEach = [&](size_t count, const auto &function) {
+    const auto body = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        function(i);
+      }
+    };
+    if (jobSystem) {
+      jobSystem->parallelFor(count, grainSize, body);
+    } else {
+      body(0, count);
+    }
+  };
+
+  auto &animation = m_Animations[animationIdx];
+  forEach(animation.translations.size(), [&](size_t i) {
+    auto &channel = animation.translations[i];
+    float value[3];
+    sample(animation.samplers[channel.sampler], channel.cursor, time, false,
+        value);
+    m_Translations[channel.flatIdx] = glm::vec3(value[0], value[1], value[2]);
+  });
+  forEach(animation.rotations.size(), [&](size_t i) {
+    auto &channel = animation.rotations[i];
+    float value[4];
+    sample(animation.samplers[channel.sampler], channel.cursor, time, true,
+        value);
+    m_Rotations[channel.flatIdx] =
+        glm::normalize(glm::quat(value[3], value[0], value[1], value[2]));
+  });
+  forEach(animation.scales.size(), [&](size_t i) {
+    auto &channel = animation.scales[i];
+    float value[3];
+    sample(animation.samplers[channel.sampler], channel.cursor, time, false,
+        value);
+    m_Scales[channel.flatIdx] = glm::vec3(value[0], value[1], value[2]);
+  });
+  forEach(animation.weights.size(), [&](size_t i) {
+    auto &channel = animation.weights[i];
+    sample(animation.samplers[channel.sampler], channel.cursor, time, false,
+        morphWeights.data() + morphWeightOffsets[channel.flatIdx]);
+  });
+  forEach(animation.nodes.size(), [&](size_t i) {
+    const auto flatIdx = animation.nodes[i];
+    m_LocalMatrices[flatIdx] = localMatrix(flatIdx);
+  });
+  // Marks nodes dirty, not thread safe
+  for (const auto flatIdx : animation.nodes) {
+    sceneGraph.setLocalMatrix(flatIdx, m_LocalMatrices[flatIdx]);
+  }
+}
+
+void Animations::reset(SceneGraph &sceneGraph)
+{
+  for (const auto &animation : m_Animations) {
+    for (const auto flatIdx : animation.nodes) {
+      m_Translations[flatIdx] = m_RestTranslations[flatIdx];
+      m_Rotations[flatIdx] = m_RestRotations[flatIdx];
+      m_Scales[flatIdx] = m_RestScales[flatIdx];
+      sceneGraph.setLocalMatrix(flatIdx, localMatrix(flatIdx));
+    }
+  }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "gltf.hpp"
+#include "scene_graph.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Keyframe animations of a scene, played by setting the local matrices of the
+// animated nodes and the morph target weights of their meshes. Samplers are
+// converted once to flat float arrays, key times on one side and values on
+// the other, and channels are grouped by target path so that a path is
+// evaluated by a single loop. Each channel keeps a cursor on its current key:
+// while time increases, the key is found by moving the cursor forward, in
+// amortized constant time, and a binary search is only done when time goes
+// backward (a loop or a seek). Channels are independent, so that a JobSystem
+// can evaluate them in parallel.
+class Animations
+{
+public:
+  Animations(const tinygltf::Model &model, const GltfBuffers &buffers,
+      const SceneGraph &sceneGraph);
+
+  size_t size() const { return m_Animations.size(); }
+
+  const std::string &name(size_t animationIdx) const
+  {
+    return m_Animations[animationIdx].name;
+  }
+
+  // Time of the last key of the animation, in seconds
+  float duration(size_t animationIdx) const
+  {
+    return m_Animations[animationIdx].duration;
+  }
+
+  // Evaluate an animation at time, clamped to the keys of each sampler: set
+  // the local matrices of its nodes in sceneGraph, and the weights of its
+  // morph channels in morphWeights, at the offsets of their flat nodes.
+  // Channels and nodes are partitioned between the threads of jobSystem if
+  // not null.
+  void apply(size_t animationIdx, float time, SceneGraph &sceneGraph,
+      std::vector<float> &morphWeights,
+      const std::vector<uint32_t> &morphWeightOffsets,
+      JobSystem *jobSystem = nullptr);
+
+  // Set the local matrices of all animated nodes back to the ones of the model
+  void reset(SceneGraph &sceneGraph);
+
+private:
+  enum class Interpolation
+  {
+    Step,
+    Linear,
+    CubicSpline
+  };
+
+  struct Sampler
+  {
+    Interpolation interpolation;
+    uint32_t firstTime; // In m_Times
+    uint32_t keyCount;
+    uint32_t firstValue; // In m_Values, keys are consecutive
+    uint32_t componentCount; // Of a value
+  };
+
+  struct Channel
+  {
+    uint32_t sampler; // In the samplers of the animation
+    uint32_t flatIdx;
+    uint32_t cursor; // Last key evaluated, not shared with other channels
+  };
+
+  struct Animation
+  {
+    std::string name;
+    float duration = 0.f;
+    std::vector<Sampler> samplers;
+    std::vector<Channel> translations;
+    std::vector<Channel> rotations;
+    std::vector<Channel> scales;
+    std::vector<Channel> weights;
+    std::vector<uint32_t> nodes; // Flat nodes with a TRS channel, unique
+  };
+
+  // Evaluate a sampler at time to out, of componentCount floats, from the key
+  // at cursor. Linear rotations are interpolated along the sphere.
+  void sample(const Sampler &sampler, uint32_t &cursor, float time,
+      bool rotation, float *out) const;
+
+  glm::mat4 localMatrix(size_t flatIdx) const;
+
+  std::vector<Animation> m_Animations;
+  std::vector<float> m_Times; // Of all samplers
+  std::vector<float> m_Values;
+
+  // Transforms of the flat nodes, as set by the animations, and as in the
+  // model
+  std::vector<glm::vec3> m_Translations;
+  std::vector<glm::quat> m_Rotations;
+  std::vector<glm::vec3> m_Scales;
+  std::vector<glm::vec3> m_RestTranslations;
+  std::vector<glm::quat> m_RestRotations;
+  std::vector<glm::vec3> m_RestScales;
+  std::vector<glm::mat4> m_LocalMatrices;
+};
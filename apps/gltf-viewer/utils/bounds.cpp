@@ -0,0 +1,171 @@
+#include "bounds.hpp"
+
+#include <cstring>
+
+// SSE is part of x86-64: positions are scanned 4 floats at a time there
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BOUNDS_USE_SSE
+#endif
+
+// Bounds of count float vec3, byteStride bytes apart
+static Aabb scanPositions(
+    const unsigned char *positions, size_t count, size_t byteStride)
+{
+  Aabb bounds;
+  if (!count) {
+    return bounds;
+  }
+  const auto *lastPosition = positions + (count - 1) * byteStride;
+#ifdef BOUNDS_USE_SSE
+  // A position is loaded with the float after it, ignored. The last one is
+  // loaded separately, not to read past the end of the buffer.
+  auto minimum = _mm_set1_ps(std::numeric_limits<float>::max());
+  auto maximum = _mm_set1_ps(std::numeric_limits<float>::lowest());
+  for (const auto *position = positions; position != lastPosition;
+       position += byteStride) {
+    const auto value = _mm_loadu_ps((const float *)position);
+    minimum = _mm_min_ps(minimum, value);
+    maximum = _mm_max_ps(maximum, value);
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, minimum);
+  bounds.min = glm::vec3(lanes[0], lanes[1], lanes[2]);
+  _mm_storeu_ps(lanes, maximum);
+  bounds.max = glm::vec3(lanes[0], lanes[1], lanes[2]);
+#else
+  for (const auto *position = positions; position != lastPosition;
+       position += byteStride) {
+    glm::vec3 value;
+    std::memcpy(&value, position, sizeof(value));
+    bounds.extend(value);
+  }
+#endif
+  glm::vec3 value;
+  std::memcpy(&value, lastPosition, sizeof(value));
+  bounds.extend(value);
+  return bounds;
+}
+
+Aabb transformAabb(const Aabb &box, const glm::mat4 &matrix)
+{
+  if (box.isEmpty()) {
+    return box;
+  }
+  // Arvo's method: each output axis is the translation plus the extremes of
+  // the products of a matrix row with the input interval
+  Aabb result;
+  result.min = result.max = glm::vec3(matrix[3]);
+  for (int column = 0; column < 3; ++column) {
+    for (int row = 0; row < 3; ++row) {
+      const auto a = matrix[column][row] * box.min[column];
+      const auto b = matrix[column][row] * box.max[column];
+      result.min[row] += glm::min(a, b);
+      result.max[row] += glm::max(a, b);
+    }
+  }
+  return result;
+}
+
+// Bounds of the elements of a VEC3 accessor
+static Aabb getAccessorBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Accessor &accessor)
+{
+  Aabb bounds;
+  if (accessor.type != TINYGLTF_TYPE_VEC3) {
+    return bounds;
+  }
+  // min and max are required by the specification for positions
+  if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3) {
+    bounds.min = glm::vec3(float(accessor.minValues[0]),
+        float(accessor.minValues[1]), float(accessor.minValues[2]));
+    bounds.max = glm::vec3(float(accessor.maxValues[0]),
+        float(accessor.maxValues[1]), float(accessor.maxValues[2]));
+    return bounds;
+  }
+
+  // All positions of the accessor, like its min and max would: vertices not
+  // referenced by indices are rare, and each vertex is read once
+  const AccessorView<glm::vec3> positions(model, buffers, accessor);
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT &&
+      accessor.bufferView >= 0 && !accessor.sparse.isSparse &&
+      positions.valid()) {
+    const auto &bufferView = model.bufferViews[accessor.bufferView];
+    const auto byteStride =
+        bufferView.byteStride ? bufferView.byteStride : sizeof(glm::vec3);
+    return scanPositions(buffers.data(bufferView.buffer) +
+                             bufferView.byteOffset + accessor.byteOffset,
+        accessor.count, byteStride);
+  }
+  // Quantized or sparse positions
+  for (const auto &position : positions) {
+    bounds.extend(position);
+  }
+  return bounds;
+}
+
+Aabb getPrimitiveBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Primitive &primitive)
+{
+  const auto positionIt = primitive.attributes.find("POSITION");
+  if (positionIt == end(primitive.attributes)) {
+    return Aabb();
+  }
+  auto bounds =
+      getAccessorBounds(model, buffers, model.accessors[positionIt->second]);
+  // Position deltas of morph targets, for weights in [0, 1]
+  for (const auto &target : primitive.targets) {
+    const auto targetPositionIt = target.find("POSITION");
+    if (bounds.isEmpty() || targetPositionIt == end(target)) {
+      continue;
+    }
+    const auto deltaBounds = getAccessorBounds(
+        model, buffers, model.accessors[targetPositionIt->second]);
+    if (!deltaBounds.isEmpty()) {
+      bounds.min += glm::min(deltaBounds.min, glm::vec3(0.f));
+      bounds.max += glm::max(deltaBounds.max, glm::vec3(0.f));
+    }
+  }
+  return bounds;
+}
+
+Frustum::Frustum(const glm::mat4 &viewProjMatrix)
+{
+  // Gribb and Hartmann: -w <= x, y, z <= w in clip space
+  const auto m = glm::transpose(viewProjMatrix); // Rows as columns
+  planes[0] = m[3] + m[0]; // Left
+  planes[1] = m[3] - m[0]; // Right
+  planes[2] = m[3] + m[1]; // Bottom
+  planes[3] = m[3] - m[1]; // Top
+  planes[4] = m[3] + m[2]; // Near
+  planes[5] = m[3] - m[2]; // Far
+}
+
+bool Frustum::intersects(const Aabb &box) const
+{
+  for (const auto &plane : planes) {
+    // Corner of the box the furthest along the plane normal
+    const glm::vec3 corner(plane.x >= 0.f ? box.max.x : box.min.x,
+        plane.y >= 0.f ? box.max.y : box.min.y,
+        plane.z >= 0.f ? box.max.z : box.min.z);
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::contains(const Aabb &box) const
+{
+  for (const auto &plane : planes) {
+    // Corner of the box the least far along the plane normal
+    const glm::vec3 corner(plane.x >= 0.f ? box.min.x : box.max.x,
+        plane.y >= 0.f ? box.min.y : box.max.y,
+        plane.z >= 0.f ? box.min.z : box.max.z);
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f) {
+      return false;
+    }
+  }
+  return true;
+}
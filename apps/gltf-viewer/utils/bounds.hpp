@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <limits>
+
+// Axis aligned bounding box, empty when min > max
+struct Aabb
+{
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+  bool isEmpty() const { return min.x > max.x; }
+
+  void extend(const glm::vec3 &point)
+  {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void extend(const Aabb &box)
+  {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+};
+
+// Bounding box of box transformed by an affine matrix
+Aabb transformAabb(const Aabb &box, const glm::mat4 &matrix);
+
+// Bounds of the positions of a primitive, in its local space: from the min
+// and max of its POSITION accessor when present, by a scan of the positions
+// otherwise. They include its morph targets for weights in [0, 1]. Empty if
+// they cannot be known.
+Aabb getPrimitiveBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Primitive &primitive);
+
+// The six planes of a view frustum, as (normal, distance) with normals
+// pointing inside
+struct Frustum
+{
+  glm::vec4 planes[6];
+
+  Frustum() = default;
+
+  // Planes of the clip space of viewProjMatrix
+  explicit Frustum(const glm::mat4 &viewProjMatrix);
+
+  // False if box is entirely outside of a plane. Conservative: boxes crossing
+  // the extension of two planes near a corner are kept.
+  bool intersects(const Aabb &box) const;
+
+  // True if box is entirely inside all planes
+  bool contains(const Aabb &box) const;
+};
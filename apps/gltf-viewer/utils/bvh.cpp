@@ -0,0 +1,230 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+
+// Half of the surface area of box, proportional to the probability of a ray
+// hitting it
+static float halfArea(const Aabb &box)
+{
+  const auto extent = box.max - box.min;
+  return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+// Distance along the ray to the entry point in box, infinity if missed
+static float rayDistance(
+    const Aabb &box, const glm::vec3 &origin, const glm::vec3 &invDirection)
+{
+  const auto t0 = (box.min - origin) * invDirection;
+  const auto t1 = (box.max - origin) * invDirection;
+  const auto tNear = glm::min(t0, t1);
+  const auto tFar = glm::max(t0, t1);
+  const auto entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.f));
+  const auto exit = glm::min(glm::min(tFar.x, tFar.y), tFar.z);
+  return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+void Bvh::build(const std::vector<Aabb> &itemBounds)
+{
+  m_Nodes.clear();
+  m_ItemIndices.clear();
+  m_UnboundedItems.clear();
+  m_ItemBounds = itemBounds;
+  for (uint32_t itemIdx = 0; itemIdx < itemBounds.size(); ++itemIdx) {
+    if (itemBounds[itemIdx].isEmpty()) {
+      m_UnboundedItems.push_back(itemIdx);
+    } else {
+      m_ItemIndices.push_back(itemIdx);
+    }
+  }
+  if (m_ItemIndices.empty()) {
+    return;
+  }
+
+  // A binary tree with at least one item per leaf has at most 2n - 1 nodes
+  m_Nodes.reserve(2 * m_ItemIndices.size() - 1);
+  m_Nodes.push_back(Node{Aabb(), 0, uint32_t(m_ItemIndices.size()), 0});
+  std::vector<uint32_t> stack{0};
+  while (!stack.empty()) {
+    const auto nodeIdx = stack.back();
+    stack.pop_back();
+    auto &node = m_Nodes[nodeIdx];
+    for (uint32_t i = 0; i < node.itemCount; ++i) {
+      node.bounds.extend(m_ItemBounds[m_ItemIndices[node.firstItem + i]]);
+    }
+    split(nodeIdx);
+    if (m_Nodes[nodeIdx].firstChild) {
+      stack.push_back(m_Nodes[nodeIdx].firstChild);
+      stack.push_back(m_Nodes[nodeIdx].firstChild + 1);
+    }
+  }
+}
+
+void Bvh::split(uint32_t nodeIdx)
+{
+  const auto node = m_Nodes[nodeIdx];
+  if (node.itemCount <= MAX_LEAF_ITEM_COUNT) {
+    return;
+  }
+  const auto itemsBegin = begin(m_ItemIndices) + node.firstItem;
+  const auto itemsEnd = itemsBegin + node.itemCount;
+  const auto centroid = [&](uint32_t itemIdx) {
+    return 0.5f * (m_ItemBounds[itemIdx].min + m_ItemBounds[itemIdx].max);
+  };
+
+  // Split along the axis where centroids spread the most
+  Aabb centroidBounds;
+  std::for_each(itemsBegin, itemsEnd,
+      [&](uint32_t itemIdx) { centroidBounds.extend(centroid(itemIdx)); });
+  const auto extent = centroidBounds.max - centroidBounds.min;
+  const int axis =
+      extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                          : (extent.y > extent.z ? 1 : 2);
+  if (extent[axis] <= 0.f) {
+    return; // Same centroids, cannot be split by position
+  }
+
+  // Surface area heuristic on bins of centroids
+  const auto binScale = BIN_COUNT / extent[axis];
+  const auto binIndex = [&](uint32_t itemIdx) {
+    const auto bin =
+        int((centroid(itemIdx)[axis] - centroidBounds.min[axis]) * binScale);
+    return std::min(bin, int(BIN_COUNT) - 1);
+  };
+  Aabb binBounds[BIN_COUNT];
+  uint32_t binCounts[BIN_COUNT] = {};
+  std::for_each(itemsBegin, itemsEnd, [&](uint32_t itemIdx) {
+    const auto bin = binIndex(itemIdx);
+    binBounds[bin].extend(m_ItemBounds[itemIdx]);
+    ++binCounts[bin];
+  });
+
+  // Cost of the items of the bins on the right of each split plane
+  float rightCosts[BIN_COUNT];
+  Aabb rightBounds;
+  uint32_t rightCount = 0;
+  for (auto bin = BIN_COUNT - 1; bin > 0; --bin) {
+    rightBounds.extend(binBounds[bin]);
+    rightCount += binCounts[bin];
+    rightCosts[bin] = rightCount ? rightCount * halfArea(rightBounds) : 0.f;
+  }
+  auto bestCost = std::numeric_limits<float>::max();
+  uint32_t bestSplit = 0; // First bin on the right
+  Aabb leftBounds;
+  uint32_t leftCount = 0;
+  for (uint32_t bin = 1; bin < BIN_COUNT; ++bin) {
+    leftBounds.extend(binBounds[bin - 1]);
+    leftCount += binCounts[bin - 1];
+    const auto cost =
+        (leftCount ? leftCount * halfArea(leftBounds) : 0.f) + rightCosts[bin];
+    if (leftCount && leftCount < node.itemCount && cost < bestCost) {
+      bestCost = cost;
+      bestSplit = bin;
+    }
+  }
+  if (!bestSplit) {
+    return;
+  }
+
+  const auto middle = std::partition(itemsBegin, itemsEnd,
+      [&](uint32_t itemIdx) { return binIndex(itemIdx) < int(bestSplit); });
+  const auto leftItemCount = uint32_t(middle - itemsBegin);
+  const auto firstChild = uint32_t(m_Nodes.size());
+  m_Nodes.push_back(Node{Aabb(), node.firstItem, leftItemCount, 0});
+  m_Nodes.push_back(Node{Aabb(), node.firstItem + leftItemCount,
+      node.itemCount - leftItemCount, 0});
+  m_Nodes[nodeIdx].firstChild = firstChild;
+}
+
+void Bvh::refit(const std::vector<Aabb> &itemBounds)
+{
+  m_ItemBounds = itemBounds;
+  // Children are after their parent
+  for (auto nodeIdx = m_Nodes.size(); nodeIdx-- > 0;) {
+    auto &node = m_Nodes[nodeIdx];
+    node.bounds = Aabb();
+    if (node.firstChild) {
+      node.bounds.extend(m_Nodes[node.firstChild].bounds);
+      node.bounds.extend(m_Nodes[node.firstChild + 1].bounds);
+    } else {
+      for (uint32_t i = 0; i < node.itemCount; ++i) {
+        node.bounds.extend(m_ItemBounds[m_ItemIndices[node.firstItem + i]]);
+      }
+    }
+  }
+}
+
+void Bvh::appendItems(const Node &node, std::vector<uint32_t> &items) const
+{
+  const auto itemsBegin = begin(m_ItemIndices) + node.firstItem;
+  items.insert(end(items), itemsBegin, itemsBegin + node.itemCount);
+}
+
+void Bvh::queryFrustum(
+    const Frustum &frustum, std::vector<uint32_t> &items) const
+{
+  items.insert(end(items), begin(m_UnboundedItems), end(m_UnboundedItems));
+  if (m_Nodes.empty()) {
+    return;
+  }
+  std::vector<uint32_t> stack{0};
+  while (!stack.empty()) {
+    const auto &node = m_Nodes[stack.back()];
+    stack.pop_back();
+    if (!frustum.intersects(node.bounds)) {
+      continue;
+    }
+    // Items of nodes entirely inside do not need to be tested
+    if (frustum.contains(node.bounds)) {
+      appendItems(node, items);
+    } else if (node.firstChild) {
+      stack.push_back(node.firstChild);
+      stack.push_back(node.firstChild + 1);
+    } else {
+      for (uint32_t i = 0; i < node.itemCount; ++i) {
+        const auto itemIdx = m_ItemIndices[node.firstItem + i];
+        if (frustum.intersects(m_ItemBounds[itemIdx])) {
+          items.push_back(itemIdx);
+        }
+      }
+    }
+  }
+}
+
+int Bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+    float &distance) const
+{
+  if (m_Nodes.empty()) {
+    return -1;
+  }
+  const auto invDirection = 1.f / direction;
+  int closestItem = -1;
+  std::vector<uint32_t> stack{0};
+  while (!stack.empty()) {
+    const auto &node = m_Nodes[stack.back()];
+    stack.pop_back();
+    if (rayDistance(node.bounds, origin, invDirection) >= distance) {
+      continue;
+    }
+    if (node.firstChild) {
+      // Visit the closest child first, to shorten the ray early
+      const auto &left = m_Nodes[node.firstChild];
+      const auto &right = m_Nodes[node.firstChild + 1];
+      const auto leftFirst = rayDistance(left.bounds, origin, invDirection) <=
+                             rayDistance(right.bounds, origin, invDirection);
+      stack.push_back(node.firstChild + (leftFirst ? 1 : 0));
+      stack.push_back(node.firstChild + (leftFirst ? 0 : 1));
+      continue;
+    }
+    for (uint32_t i = 0; i < node.itemCount; ++i) {
+      const auto itemIdx = m_ItemIndices[node.firstItem + i];
+      const auto itemDistance =
+          rayDistance(m_ItemBounds[itemIdx], origin, invDirection);
+      if (itemDistance < distance) {
+        distance = itemDistance;
+        closestItem = int(itemIdx);
+      }
+    }
+  }
+  return closestItem;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over the bounds of items (the draws of a scene),
+// for frustum culling and picking in logarithmic time. It is built with a
+// binned surface area heuristic. refit updates the bounds of the nodes for
+// moved items without changing the tree: it is fast, but queries get slower
+// if items move a lot relative to each other, build it again then.
+// Items with empty bounds are always returned by frustum queries and never
+// hit by rays.
+class Bvh
+{
+public:
+  void build(const std::vector<Aabb> &itemBounds);
+
+  // itemBounds must have the same size as for build
+  void refit(const std::vector<Aabb> &itemBounds);
+
+  // Append to items the items whose bounds intersect frustum, in no
+  // particular order
+  void queryFrustum(
+      const Frustum &frustum, std::vector<uint32_t> &items) const;
+
+  // Closest item whose bounds are hit by the ray at a distance smaller than
+  // distance, which is then set to the distance of the hit. direction is not
+  // necessarily normalized: distances are in units of its length. -1 if none.
+  int raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+      float &distance) const;
+
+  // Bounds of all items with bounds
+  Aabb bounds() const { return m_Nodes.empty() ? Aabb() : m_Nodes[0].bounds; }
+
+  size_t nodeCount() const { return m_Nodes.size(); }
+
+private:
+  // Nodes cover a range of m_ItemIndices. Children of internal nodes are
+  // consecutive and after their parent in m_Nodes.
+  struct Node
+  {
+    Aabb bounds;
+    uint32_t firstItem;
+    uint32_t itemCount;
+    uint32_t firstChild; // 0 for leaves, the root being nobody's child
+  };
+
+  void split(uint32_t nodeIdx);
+
+  void appendItems(const Node &node, std::vector<uint32_t> &items) const;
+
+  static const uint32_t MAX_LEAF_ITEM_COUNT = 4;
+  static const uint32_t BIN_COUNT = 12;
+
+  std::vector<Node> m_Nodes;
+  std::vector<uint32_t> m_ItemIndices; // Items with bounds, in node order
+  std::vector<uint32_t> m_UnboundedItems;
+  std::vector<Aabb> m_ItemBounds;
+};
@@ -0,0 +1,563 @@
+#include "geometry_batch.hpp"
+#include "job_system.hpp"
+#include "lod_cache.hpp"
+#include "meshlets.hpp"
+#include "shader_blocks.hpp"
+#include "simplify.hpp"
+#include "vertex_cache.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+struct BatchVertex
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 texCoords;
+  glm::vec4 tangent;
+  glm::u16vec4 joints;
+  glm::u16vec4 weights; // Normalized
+};
+
+// Attributes of the vertex layout, with the accessor type they are read from
+// and the format they are stored in
+struct BatchAttribute
+{
+  const char *name;
+  int type;
+  GLuint location;
+  size_t offset; // In BatchVertex
+  GLenum componentType; // GL_FLOAT or GL_UNSIGNED_SHORT
+  GLboolean normalized;
+  bool integer; // Read as integers by the shaders
+};
+
+const BatchAttribute BATCH_ATTRIBUTES[] = {
+    {"POSITION", TINYGLTF_TYPE_VEC3, VERTEX_ATTRIB_POSITION_IDX,
+        offsetof(BatchVertex, position), GL_FLOAT, GL_FALSE, false},
+    {"NORMAL", TINYGLTF_TYPE_VEC3, VERTEX_ATTRIB_NORMAL_IDX,
+        offsetof(BatchVertex, normal), GL_FLOAT, GL_FALSE, false},
+    {"TEXCOORD_0", TINYGLTF_TYPE_VEC2, VERTEX_ATTRIB_TEXCOORD0_IDX,
+        offsetof(BatchVertex, texCoords), GL_FLOAT, GL_FALSE, false},
+    {"TANGENT", TINYGLTF_TYPE_VEC4, VERTEX_ATTRIB_TANGENT_IDX,
+        offsetof(BatchVertex, tangent), GL_FLOAT, GL_FALSE, false},
+    {"JOINTS_0", TINYGLTF_TYPE_VEC4, VERTEX_ATTRIB_JOINTS0_IDX,
+        offsetof(BatchVertex, joints), GL_UNSIGNED_SHORT, GL_FALSE, true},
+    {"WEIGHTS_0", TINYGLTF_TYPE_VEC4, VERTEX_ATTRIB_WEIGHTS0_IDX,
+        offsetof(BatchVertex, weights), GL_UNSIGNED_SHORT, GL_TRUE, false}};
+
+// Compact layout of the quantized primitives: positions as 16 bits normalized
+// integers in the bounds of their primitive, normals and tangents as 10 bits
+// signed normalized integers and texcoords as half floats
+struct QuantizedVertex
+{
+  glm::u16vec4 position; // w unused
+  uint32_t normal; // GL_INT_2_10_10_10_REV
+  glm::u16vec2 texCoords;
+  uint32_t tangent; // GL_INT_2_10_10_10_REV, sign of the bitangent in w
+};
+
+// Format of an attribute in a vertex buffer
+struct VertexFormat
+{
+  GLuint location;
+  GLint componentCount;
+  GLenum componentType;
+  GLboolean normalized;
+  bool integer; // Read as integers by the shaders
+  size_t offset;
+};
+
+// Joints and weights are not quantized: skinned primitives are not
+const VertexFormat QUANTIZED_VERTEX_FORMATS[] = {
+    {VERTEX_ATTRIB_POSITION_IDX, 3, GL_UNSIGNED_SHORT, GL_TRUE, false,
+        offsetof(QuantizedVertex, position)},
+    {VERTEX_ATTRIB_NORMAL_IDX, 4, GL_INT_2_10_10_10_REV, GL_TRUE, false,
+        offsetof(QuantizedVertex, normal)},
+    {VERTEX_ATTRIB_TEXCOORD0_IDX, 2, GL_HALF_FLOAT, GL_FALSE, false,
+        offsetof(QuantizedVertex, texCoords)},
+    {VERTEX_ATTRIB_TANGENT_IDX, 4, GL_INT_2_10_10_10_REV, GL_TRUE, false,
+        offsetof(QuantizedVertex, tangent)}};
+
+// Store the components of value in the format of attribute
+void storeAttribute(
+    const BatchAttribute &attribute, const glm::vec4 &value, void *dst)
+{
+  const auto componentCount = tinygltf::GetNumComponentsInType(attribute.type);
+  if (attribute.componentType == GL_FLOAT) {
+    std::memcpy(dst, &value, componentCount * sizeof(float));
+    return;
+  }
+  uint16_t components[4];
+  for (int c = 0; c < componentCount; ++c) {
+    components[c] = attribute.normalized
+                        ? uint16_t(glm::clamp(value[c], 0.f, 1.f) * 65535.f + .5f)
+                        : uint16_t(value[c]);
+  }
+  std::memcpy(dst, components, componentCount * sizeof(uint16_t));
+}
+
+// Primitives are decoded by chunks of about this many vertices
+const size_t CHUNK_VERTEX_COUNT = 1024 * 1024;
+
+glm::vec3 normalizeOrZero(const glm::vec3 &v)
+{
+  const auto length = glm::length(v);
+  return length > 0.f ? v / length : v;
+}
+} // namespace
+
+// Vertex count of a primitive that fits the batch layout, 0 otherwise
+static size_t batchableVertexCount(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Primitive &primitive)
+{
+  const auto positionIt = primitive.attributes.find("POSITION");
+  if (positionIt == end(primitive.attributes)) {
+    return 0;
+  }
+  const auto vertexCount = model.accessors[positionIt->second].count;
+  for (const auto &attribute : BATCH_ATTRIBUTES) {
+    const auto it = primitive.attributes.find(attribute.name);
+    if (it == end(primitive.attributes)) {
+      continue;
+    }
+    // Any component type converts to float
+    const auto &accessor = model.accessors[it->second];
+    if (accessor.type != attribute.type || accessor.count < vertexCount ||
+        !AccessorView<float>(model, buffers, accessor).valid()) {
+      return 0;
+    }
+  }
+  if (primitive.indices >= 0) {
+    const auto &accessor = model.accessors[primitive.indices];
+    if (accessor.type != TINYGLTF_TYPE_SCALAR ||
+        accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      return 0;
+    }
+    const AccessorView<uint32_t> view(model, buffers, accessor);
+    if (!view.valid()) {
+      return 0;
+    }
+    // Simplification, cache optimization and meshlets index arrays of
+    // vertices with them
+    for (const auto index : view) {
+      if (index >= vertexCount) {
+        return 0;
+      }
+    }
+  }
+  return vertexCount;
+}
+
+// Quantize the vertices of a primitive to quantizedVertices, and return the
+// matrix from quantized positions to positions
+static glm::mat4 quantizePrimitiveVertices(const BatchVertex *vertices,
+    size_t vertexCount, QuantizedVertex *quantizedVertices)
+{
+  glm::vec3 boundsMin(std::numeric_limits<float>::max());
+  glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < vertexCount; ++i) {
+    boundsMin = glm::min(boundsMin, vertices[i].position);
+    boundsMax = glm::max(boundsMax, vertices[i].position);
+  }
+  // Flat axes keep a unit scale
+  auto scale = boundsMax - boundsMin;
+  for (int c = 0; c < 3; ++c) {
+    if (!(scale[c] > 0.f)) {
+      scale[c] = 1.f;
+    }
+  }
+  if (!vertexCount) {
+    boundsMin = glm::vec3(0.f);
+  }
+
+  for (size_t i = 0; i < vertexCount; ++i) {
+    const auto &vertex = vertices[i];
+    auto &quantizedVertex = quantizedVertices[i];
+    const auto position =
+        glm::clamp((vertex.position - boundsMin) / scale, 0.f, 1.f);
+    quantizedVertex.position =
+        glm::u16vec4(glm::round(position * 65535.f), 0.f);
+    quantizedVertex.normal =
+        glm::packSnorm3x10_1x2(glm::vec4(normalizeOrZero(vertex.normal), 0.f));
+    quantizedVertex.texCoords = glm::packHalf(vertex.texCoords);
+    // Tangents are transformed by the model matrix, which then includes the
+    // dequantization: they are transformed by its inverse. Missing tangents
+    // stay zeros.
+    const glm::vec3 tangent = vertex.tangent;
+    quantizedVertex.tangent = glm::packSnorm3x10_1x2(
+        tangent == glm::vec3(0.f)
+            ? glm::vec4(0.f)
+            : glm::vec4(normalizeOrZero(tangent / scale),
+                  vertex.tangent.w < 0.f ? -1.f : 1.f));
+  }
+  return glm::scale(glm::translate(glm::mat4(1.f), boundsMin), scale);
+}
+
+// VAO reading vertices of the given formats in vertexAllocation, and the
+// indices of indexBuffer
+static GLuint createVertexArrayObject(const std::vector<VertexFormat> &formats,
+    GLsizei stride, const GpuArena::Allocation &vertexAllocation,
+    GLuint drawIndexBuffer, GLuint indexBuffer)
+{
+  GLuint vertexArrayObject = 0;
+  glGenVertexArrays(1, &vertexArrayObject);
+  glBindVertexArray(vertexArrayObject);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexAllocation.bufferObject);
+  for (const auto &format : formats) {
+    glEnableVertexAttribArray(format.location);
+    const auto *pointer =
+        (const GLvoid *)(vertexAllocation.offset + format.offset);
+    if (format.integer) {
+      glVertexAttribIPointer(format.location, format.componentCount,
+          format.componentType, stride, pointer);
+    } else {
+      glVertexAttribPointer(format.location, format.componentCount,
+          format.componentType, format.normalized, stride, pointer);
+    }
+  }
+  glEnableVertexAttribArray(VERTEX_ATTRIB_DRAW_INDEX_IDX);
+  glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+  glVertexAttribIPointer(
+      VERTEX_ATTRIB_DRAW_INDEX_IDX, 1, GL_UNSIGNED_INT, 0, nullptr);
+  glVertexAttribDivisor(VERTEX_ATTRIB_DRAW_INDEX_IDX, 1);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return vertexArrayObject;
+}
+
+// Levels of detail of a batched primitive, from lodCache or else built and
+// stored in it
+static std::vector<MeshLod> getPrimitiveLods(
+    const std::vector<glm::vec3> &positions,
+    const std::vector<uint32_t> &indices, const LodCache *lodCache)
+{
+  const auto vertexCount = positions.size();
+  const auto maxLodCount = GeometryBatch::MAX_LOD_COUNT - 1;
+  const auto key = lodCache ? LodCache::key(positions.data(), vertexCount,
+                                  indices, maxLodCount)
+                            : 0;
+  std::vector<MeshLod> lods;
+  if (lodCache && lodCache->load(key, vertexCount, lods)) {
+    return lods;
+  }
+  lods = buildLodChain(positions.data(), vertexCount, indices, maxLodCount);
+  if (lodCache) {
+    lodCache->store(key, lods);
+  }
+  return lods;
+}
+
+// A batched primitive between its decoding and its upload
+struct DecodedPrimitive
+{
+  std::vector<BatchVertex> vertices; // Empty if quantized
+  std::vector<QuantizedVertex> quantizedVertices;
+  glm::mat4 dequantizationMatrix = glm::mat4(1.f);
+  std::vector<uint32_t> indices;
+  // Of triangle lists only
+  VertexCacheStats stats;
+  VertexCacheStats optimizedStats;
+  std::vector<Meshlet> meshlets;
+  std::vector<MeshLod> lods;
+};
+
+// Decode a batched primitive, missing attributes are zeros. Triangle lists are
+// optimized and get their meshlets and levels of detail.
+static void decodePrimitive(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Primitive &primitive,
+    bool quantized, const LodCache *lodCache, bool optimizeVertexOrder,
+    DecodedPrimitive &decoded)
+{
+  const auto vertexCount =
+      model.accessors[primitive.attributes.at("POSITION")].count;
+  BatchVertex zeroVertex;
+  std::memset(&zeroVertex, 0, sizeof(zeroVertex));
+  std::vector<BatchVertex> vertices(vertexCount, zeroVertex);
+  std::vector<glm::vec4> attributeValues;
+  for (const auto &attribute : BATCH_ATTRIBUTES) {
+    const auto it = primitive.attributes.find(attribute.name);
+    if (it == end(primitive.attributes)) {
+      continue;
+    }
+    // Decoded as vec4, zeros after the components of the attribute
+    const AccessorView<glm::vec4> view(
+        model, buffers, model.accessors[it->second]);
+    attributeValues.resize(view.size());
+    view.decode(attributeValues.data());
+    for (size_t i = 0; i < vertexCount; ++i) {
+      storeAttribute(attribute, attributeValues[i],
+          (unsigned char *)&vertices[i] + attribute.offset);
+    }
+  }
+  attributeValues = std::vector<glm::vec4>();
+
+  auto &indices = decoded.indices;
+  indices = getPrimitiveIndices(model, buffers, primitive, vertexCount);
+  if (primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+    std::vector<glm::vec3> positions(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+      positions[v] = vertices[v].position;
+    }
+
+    decoded.stats =
+        analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+    if (optimizeVertexOrder) {
+      optimizeVertexCache(indices, vertexCount);
+      optimizeOverdraw(indices, positions.data(), vertexCount);
+      // Vertices of morphed primitives keep their order, that of the morph
+      // target deltas
+      if (primitive.targets.empty()) {
+        const auto remap = optimizeVertexFetch(indices, vertexCount);
+        std::vector<BatchVertex> remappedVertices(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+          remappedVertices[remap[v]] = vertices[v];
+          positions[remap[v]] = vertices[v].position;
+        }
+        vertices = std::move(remappedVertices);
+      }
+      decoded.optimizedStats =
+          analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+    } else {
+      decoded.optimizedStats = decoded.stats;
+    }
+
+    // Bounds of the positions do not hold once skinned or morphed, such
+    // primitives get no meshlets. Primitives of a single meshlet are culled as
+    // a whole anyway.
+    const bool animated = !primitive.targets.empty() ||
+                          primitive.attributes.count("JOINTS_0") ||
+                          primitive.attributes.count("WEIGHTS_0");
+    if (!animated &&
+        indices.size() / 3 > GeometryBatch::MAX_MESHLET_TRIANGLE_COUNT) {
+      decoded.meshlets = buildMeshlets(indices.data(), indices.size(),
+          positions.data(), vertexCount,
+          GeometryBatch::MAX_MESHLET_VERTEX_COUNT,
+          GeometryBatch::MAX_MESHLET_TRIANGLE_COUNT);
+    }
+
+    // The levels of a primitive have at most as many indices as the
+    // primitive, which bounds the space reserved for them
+    decoded.lods = getPrimitiveLods(positions, indices, lodCache);
+    size_t lodIndexCount = 0;
+    for (size_t lodIdx = 0; lodIdx < decoded.lods.size(); ++lodIdx) {
+      lodIndexCount += decoded.lods[lodIdx].indices.size();
+      if (lodIndexCount > indices.size()) {
+        decoded.lods.resize(lodIdx);
+        break;
+      }
+    }
+  }
+
+  if (quantized) {
+    decoded.quantizedVertices.resize(vertexCount);
+    decoded.dequantizationMatrix = quantizePrimitiveVertices(
+        vertices.data(), vertexCount, decoded.quantizedVertices.data());
+  } else {
+    decoded.vertices = std::move(vertices);
+  }
+}
+
+GeometryBatch::GeometryBatch(const tinygltf::Model &model,
+    const GltfBuffers &buffers, GpuArena &arena, GLuint drawIndexBuffer,
+    const LodCache *lodCache, JobSystem *jobSystem, bool optimizeVertexOrder,
+    bool quantizeVertices)
+{
+  // Lay out the arenas first, quantized primitives have their own vertex
+  // arena. Levels of detail come after the indices of all primitives, at most
+  // as many as those of the triangle lists.
+  size_t vertexCount = 0;
+  size_t quantizedVertexCount = 0;
+  size_t indexCount = 0;
+  size_t maxLodIndexCount = 0;
+  std::vector<const tinygltf::Primitive *> batchedPrimitives;
+  std::vector<size_t> batchedPrimitiveIndices;
+  std::vector<size_t> batchedVertexCounts;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      Primitive batchPrimitive;
+      const auto primitiveVertexCount =
+          batchableVertexCount(model, buffers, primitive);
+      if (primitiveVertexCount) {
+        batchPrimitive.batched = true;
+        // Morph target deltas and joint matrices apply to unquantized
+        // positions
+        batchPrimitive.quantized = quantizeVertices &&
+                                   primitive.targets.empty() &&
+                                   !primitive.attributes.count("JOINTS_0") &&
+                                   !primitive.attributes.count("WEIGHTS_0");
+        auto &arenaVertexCount =
+            batchPrimitive.quantized ? quantizedVertexCount : vertexCount;
+        batchPrimitive.baseVertex = GLint(arenaVertexCount);
+        batchPrimitive.firstIndex = GLuint(indexCount);
+        batchPrimitive.indexCount =
+            GLsizei(primitive.indices >= 0
+                        ? model.accessors[primitive.indices].count
+                        : primitiveVertexCount);
+        arenaVertexCount += primitiveVertexCount;
+        indexCount += batchPrimitive.indexCount;
+        if (primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+          maxLodIndexCount += batchPrimitive.indexCount;
+        }
+        batchedPrimitives.push_back(&primitive);
+        batchedPrimitiveIndices.push_back(m_Primitives.size());
+        batchedVertexCounts.push_back(primitiveVertexCount);
+        ++m_nBatchedPrimitiveCount;
+      }
+      m_Primitives.push_back(batchPrimitive);
+    }
+  }
+
+  const auto vertexByteSize = vertexCount * sizeof(BatchVertex);
+  const auto quantizedVertexByteSize =
+      quantizedVertexCount * sizeof(QuantizedVertex);
+  arena.reserve(
+      vertexByteSize + quantizedVertexByteSize + 2 * GpuArena::ALIGNMENT);
+  GpuArena::Allocation vertexAllocation;
+  if (vertexCount) {
+    vertexAllocation = arena.allocate(vertexByteSize);
+  }
+  GpuArena::Allocation quantizedVertexAllocation;
+  if (quantizedVertexCount) {
+    quantizedVertexAllocation = arena.allocate(quantizedVertexByteSize);
+  }
+  // The index count is only known once the levels are built: indices are
+  // staged in a temporary buffer, and copied to the arena at the end
+  GpuArena stagingArena(0);
+  const auto stagingAllocation = stagingArena.allocate(
+      (indexCount + maxLodIndexCount) * sizeof(uint32_t));
+
+  // Primitives are decoded and uploaded by chunks, so that only the vertices
+  // of a chunk are in memory. Optimization and simplification are slow for
+  // large meshes: the primitives of a chunk are processed in parallel.
+  size_t lodIndexCount = 0;
+  std::vector<DecodedPrimitive> decodedPrimitives;
+  for (size_t first = 0; first < batchedPrimitives.size();) {
+    auto last = first;
+    size_t chunkVertexCount = 0;
+    while (last < batchedPrimitives.size() &&
+           (last == first || chunkVertexCount + batchedVertexCounts[last] <=
+                                 CHUNK_VERTEX_COUNT)) {
+      chunkVertexCount += batchedVertexCounts[last++];
+    }
+
+    decodedPrimitives.resize(last - first);
+    const auto decodePrimitives = [&](size_t chunkFirst, size_t chunkLast) {
+      for (auto i = chunkFirst; i < chunkLast; ++i) {
+        decodePrimitive(model, buffers, *batchedPrimitives[first + i],
+            m_Primitives[batchedPrimitiveIndices[first + i]].quantized,
+            lodCache, optimizeVertexOrder, decodedPrimitives[i]);
+      }
+    };
+    if (jobSystem) {
+      jobSystem->parallelFor(decodedPrimitives.size(), 1, decodePrimitives);
+    } else {
+      decodePrimitives(0, decodedPrimitives.size());
+    }
+
+    for (auto i = first; i < last; ++i) {
+      auto &batchPrimitive = m_Primitives[batchedPrimitiveIndices[i]];
+      const auto &decoded = decodedPrimitives[i - first];
+      if (batchPrimitive.quantized) {
+        batchPrimitive.dequantizationMatrix = decoded.dequantizationMatrix;
+        arena.upload(quantizedVertexAllocation,
+            batchPrimitive.baseVertex * sizeof(QuantizedVertex),
+            decoded.quantizedVertices.data(),
+            decoded.quantizedVertices.size() * sizeof(QuantizedVertex));
+      } else {
+        arena.upload(vertexAllocation,
+            batchPrimitive.baseVertex * sizeof(BatchVertex),
+            decoded.vertices.data(),
+            decoded.vertices.size() * sizeof(BatchVertex));
+      }
+      stagingArena.upload(stagingAllocation,
+          batchPrimitive.firstIndex * sizeof(uint32_t), decoded.indices.data(),
+          decoded.indices.size() * sizeof(uint32_t));
+
+      if (batchedPrimitives[i]->mode != TINYGLTF_MODE_TRIANGLES) {
+        continue;
+      }
+      m_VertexCacheStats += decoded.stats;
+      m_OptimizedVertexCacheStats += decoded.optimizedStats;
+      batchPrimitive.firstMeshlet = m_MeshletRanges.size();
+      batchPrimitive.meshletCount = decoded.meshlets.size();
+      for (const auto &meshlet : decoded.meshlets) {
+        m_MeshletRanges.push_back(
+            MeshletRange{batchPrimitive.firstIndex + meshlet.firstIndex,
+                GLsizei(meshlet.triangleCount * 3)});
+        m_MeshletBounds.push(meshlet);
+      }
+      batchPrimitive.lods.push_back(
+          Lod{batchPrimitive.firstIndex, batchPrimitive.indexCount, 0.f});
+      for (const auto &lod : decoded.lods) {
+        const auto firstIndex = indexCount + lodIndexCount;
+        batchPrimitive.lods.push_back(Lod{
+            GLuint(firstIndex), GLsizei(lod.indices.size()), lod.error});
+        stagingArena.upload(stagingAllocation, firstIndex * sizeof(uint32_t),
+            lod.indices.data(), lod.indices.size() * sizeof(uint32_t));
+        lodIndexCount += lod.indices.size();
+      }
+    }
+    decodedPrimitives.clear();
+    first = last;
+  }
+
+  const auto indexByteSize = (indexCount + lodIndexCount) * sizeof(uint32_t);
+  arena.reserve(indexByteSize + GpuArena::ALIGNMENT);
+  const auto indexAllocation = arena.allocate(indexByteSize);
+  GpuArena::copy(stagingAllocation, 0, indexAllocation, 0, indexByteSize);
+  if (vertexCount) {
+    std::vector<VertexFormat> formats;
+    for (const auto &attribute : BATCH_ATTRIBUTES) {
+      formats.push_back(VertexFormat{attribute.location,
+          tinygltf::GetNumComponentsInType(attribute.type),
+          attribute.componentType, attribute.normalized, attribute.integer,
+          attribute.offset});
+    }
+    m_VertexArrayObject = createVertexArrayObject(formats, sizeof(BatchVertex),
+        vertexAllocation, drawIndexBuffer, indexAllocation.bufferObject);
+  }
+  if (quantizedVertexCount) {
+    m_QuantizedVertexArrayObject = createVertexArrayObject(
+        std::vector<VertexFormat>(
+            std::begin(QUANTIZED_VERTEX_FORMATS),
+            std::end(QUANTIZED_VERTEX_FORMATS)),
+        sizeof(QuantizedVertex), quantizedVertexAllocation, drawIndexBuffer,
+        indexAllocation.bufferObject);
+  }
+  m_nVertexByteSize = vertexByteSize + quantizedVertexByteSize;
+
+  // Indices are relative to the start of the element array buffer
+  const auto indexOffset = GLuint(indexAllocation.offset / sizeof(uint32_t));
+  for (auto &batchPrimitive : m_Primitives) {
+    batchPrimitive.firstIndex += indexOffset;
+    for (auto &lod : batchPrimitive.lods) {
+      lod.firstIndex += indexOffset;
+    }
+    for (size_t meshletIdx = batchPrimitive.firstMeshlet;
+         meshletIdx < batchPrimitive.firstMeshlet + batchPrimitive.meshletCount;
+         ++meshletIdx) {
+      m_MeshletRanges[meshletIdx].firstIndex += indexOffset;
+    }
+    if (batchPrimitive.batched) {
+      batchPrimitive.vertexArrayObject = batchPrimitive.quantized
+                                             ? m_QuantizedVertexArrayObject
+                                             : m_VertexArrayObject;
+    }
+  }
+}
+
+GeometryBatch::~GeometryBatch()
+{
+  glDeleteVertexArrays(1, &m_VertexArrayObject);
+  glDeleteVertexArrays(1, &m_QuantizedVertexArrayObject);
+}
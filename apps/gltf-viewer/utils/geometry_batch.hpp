@@ -0,0 +1,138 @@
+#pragma once
+
+#include "gltf.hpp"
+#include "gpu_arena.hpp"
+#include "meshlets.hpp"
+#include "vertex_cache.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <vector>
+
+class JobSystem;
+class LodCache;
+
+// Vertices and indices of the primitives of a model repacked in a shared
+// vertex arena and a shared index arena, so that primitives can be drawn by
+// glMultiDrawElementsIndirect with a single VAO.
+// Vertices have a fixed layout (float position, normal, texcoords and tangent,
+// 16 bits joints and normalized weights, zeros for missing attributes) and
+// indices are 32 bits. Attributes are
+// decoded to it by AccessorView, whatever their component type and sparse or
+// not: primitives with attributes of an unexpected type, or reading out of
+// their buffers, are not batched and keep their own VAO.
+// Triangle primitives also get levels of detail, simplified index lists in the
+// index arena drawn with the same vertices. Their triangles and vertices can be
+// reordered for the vertex cache, overdraw and vertex fetches first.
+// Primitives without morph targets nor skin can instead be quantized in a
+// second vertex arena, of about a third of the size: 16 bits positions in the
+// bounds of the primitive, 10 bits normals and tangents and half float
+// texcoords. Quantized positions are dequantized by the model matrix.
+// Large triangle lists without morph targets nor skin are also split into
+// meshlets, ranges of their indices with bounds, so that the parts of a
+// primitive out of view can be skipped.
+class GeometryBatch
+{
+public:
+  // Levels of detail of a primitive, including the primitive itself
+  static const size_t MAX_LOD_COUNT = 8;
+  // Limits of the meshlets, for their bounds to be tight
+  static const size_t MAX_MESHLET_VERTEX_COUNT = 64;
+  static const size_t MAX_MESHLET_TRIANGLE_COUNT = 124;
+
+  // A level of detail in the index arena
+  struct Lod
+  {
+    GLuint firstIndex = 0; // In the element array buffer of the VAO
+    GLsizei indexCount = 0;
+    float error = 0.f; // Object space distance to the primitive
+  };
+
+  // A primitive in the arenas
+  struct Primitive
+  {
+    bool batched = false;
+    GLuint vertexArrayObject = 0; // Of the vertex arena of the primitive
+    GLint baseVertex = 0;
+    GLuint firstIndex = 0; // In the element array buffer of the VAO
+    GLsizei indexCount = 0;
+    // Finer to coarser, the first is the primitive itself. Empty if not
+    // batched or not a triangle list.
+    std::vector<Lod> lods;
+    // From quantized positions to positions, to apply before the model matrix
+    // (but not the normal matrix) if quantized
+    bool quantized = false;
+    glm::mat4 dequantizationMatrix = glm::mat4(1.f);
+    // Meshlets of the full detail level, none if it is small or animated
+    size_t firstMeshlet = 0;
+    size_t meshletCount = 0;
+  };
+
+  // Indices of a meshlet in the index arena
+  struct MeshletRange
+  {
+    GLuint firstIndex = 0; // In the element array buffer of the VAO
+    GLsizei indexCount = 0;
+  };
+
+  // The arenas are allocated in arena. drawIndexBuffer holds the index of each
+  // draw, as an instanced attribute. Levels of detail are read from lodCache
+  // if possible, and otherwise built on the threads of jobSystem and stored in
+  // lodCache, which can both be null. Triangle lists are optimized if
+  // optimizeVertexOrder is true, before the levels of detail. Vertices are
+  // quantized if quantizeVertices is true.
+  GeometryBatch(const tinygltf::Model &model, const GltfBuffers &buffers,
+      GpuArena &arena, GLuint drawIndexBuffer,
+      const LodCache *lodCache = nullptr, JobSystem *jobSystem = nullptr,
+      bool optimizeVertexOrder = false, bool quantizeVertices = false);
+
+  ~GeometryBatch();
+
+  // Non-copyable class:
+  GeometryBatch(const GeometryBatch &) = delete;
+  GeometryBatch &operator=(const GeometryBatch &) = delete;
+
+  // Primitives of each mesh, in order: indexed like the VAOs of
+  // ViewerApplication::createVertexArrayObjects
+  const Primitive &primitive(size_t primitiveIdx) const
+  {
+    return m_Primitives[primitiveIdx];
+  }
+
+  size_t batchedPrimitiveCount() const { return m_nBatchedPrimitiveCount; }
+
+  // Of the vertex arenas
+  size_t vertexByteSize() const { return m_nVertexByteSize; }
+
+  // Of all primitives, in primitive order. Bounds are in the space of the
+  // unquantized positions of their primitive.
+  const std::vector<MeshletRange> &meshletRanges() const
+  {
+    return m_MeshletRanges;
+  }
+  const MeshletBounds &meshletBounds() const { return m_MeshletBounds; }
+
+  // Of the full detail triangle lists, as authored and once optimized (the
+  // same if they are not)
+  const VertexCacheStats &vertexCacheStats() const
+  {
+    return m_VertexCacheStats;
+  }
+  const VertexCacheStats &optimizedVertexCacheStats() const
+  {
+    return m_OptimizedVertexCacheStats;
+  }
+
+private:
+  std::vector<Primitive> m_Primitives;
+  size_t m_nBatchedPrimitiveCount = 0;
+  size_t m_nVertexByteSize = 0;
+  VertexCacheStats m_VertexCacheStats;
+  VertexCacheStats m_OptimizedVertexCacheStats;
+  std::vector<MeshletRange> m_MeshletRanges;
+  MeshletBounds m_MeshletBounds;
+  GLuint m_VertexArrayObject = 0;
+  GLuint m_QuantizedVertexArrayObject = 0;
+};
@@ -1,4 +1,5 @@
 #include "gltf.hpp"
+#include "bounds.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -35,15 +36,16 @@ glm::mat4 getLocalToWorldMatrix(
                                                  node.scale[1], node.scale[2]));
 };
 
-void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax)
+void computeSceneBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, glm::vec3 &bboxMin, glm::vec3 &bboxMax)
 {
-  // Compute scene bounding box
-  // todo refactor with scene drawing
-  // todo need a visitScene generic function that takes a accept() functor
-  bboxMin = glm::vec3(std::numeric_limits<float>::max());
-  bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
+  // Union of the bounds of the primitives transformed by the world matrix of
+  // their nodes, and by each instance matrix of instanced nodes. Primitive
+  // bounds come from accessor min and max, or a scan of the positions, and are
+  // computed once per mesh.
+  Aabb sceneBounds;
   if (model.defaultScene >= 0) {
+    std::vector<std::vector<Aabb>> meshBounds(model.meshes.size());
     const std::function<void(int, const glm::mat4 &)> updateBounds =
         [&](int nodeIdx, const glm::mat4 &parentMatrix) {
           const auto &node = model.nodes[nodeIdx];
@@ -51,94 +53,24 @@ void computeSceneBounds(
               getLocalToWorldMatrix(node, parentMatrix);
           if (node.mesh >= 0) {
             const auto &mesh = model.meshes[node.mesh];
-            for (size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
-              const auto &primitive = mesh.primitives[pIdx];
-              const auto positionAttrIdxIt =
-                  primitive.attributes.find("POSITION");
-              if (positionAttrIdxIt == end(primitive.attributes)) {
-                continue;
+            auto &primitiveBounds = meshBounds[node.mesh];
+            if (primitiveBounds.empty()) {
+              for (const auto &primitive : mesh.primitives) {
+                primitiveBounds.push_back(
+                    getPrimitiveBounds(model, buffers, primitive));
               }
-              const auto &positionAccessor =
-                  model.accessors[(*positionAttrIdxIt).second];
-              if (positionAccessor.type != 3) {
-                std::cerr << "Position accessor with type != VEC3, skipping"
-                          << std::endl;
-                continue;
+            }
+            // Instances of EXT_mesh_gpu_instancing are placed by their
+            // matrix, before the world matrix of the node
+            const auto instanceMatrices =
+                getNodeInstanceMatrices(model, buffers, node);
+            for (const auto &bounds : primitiveBounds) {
+              if (instanceMatrices.empty()) {
+                sceneBounds.extend(transformAabb(bounds, modelMatrix));
               }
-              const auto &positionBufferView =
-                  model.bufferViews[positionAccessor.bufferView];
-              const auto byteOffset =
-                  positionAccessor.byteOffset + positionBufferView.byteOffset;
-              const auto &positionBuffer =
-                  model.buffers[positionBufferView.buffer];
-              const auto positionByteStride =
-                  positionBufferView.byteStride ? positionBufferView.byteStride
-                                                : 3 * sizeof(float);
-
-              if (primitive.indices >= 0) {
-                const auto &indexAccessor = model.accessors[primitive.indices];
-                const auto &indexBufferView =
-                    model.bufferViews[indexAccessor.bufferView];
-                const auto indexByteOffset =
-                    indexAccessor.byteOffset + indexBufferView.byteOffset;
-                const auto &indexBuffer = model.buffers[indexBufferView.buffer];
-                auto indexByteStride = indexBufferView.byteStride;
-
-                switch (indexAccessor.componentType) {
-                default:
-                  std::cerr
-                      << "Primitive index accessor with bad componentType "
-                      << indexAccessor.componentType << ", skipping it."
-                      << std::endl;
-                  continue;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint8_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint16_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint32_t);
-                  break;
-                }
-
-                for (size_t i = 0; i < indexAccessor.count; ++i) {
-                  uint32_t index = 0;
-                  switch (indexAccessor.componentType) {
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                    index = *((const uint8_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                    index = *((const uint16_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                    index = *((const uint32_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  }
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * index]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
-              } else {
-                for (size_t i = 0; i < positionAccessor.count; ++i) {
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * i]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
+              for (const auto &instanceMatrix : instanceMatrices) {
+                sceneBounds.extend(
+                    transformAabb(bounds, modelMatrix * instanceMatrix));
               }
             }
           }
@@ -150,4 +82,78 @@ void computeSceneBounds(
       updateBounds(nodeIdx, glm::mat4(1));
     }
   }
-}
\ No newline at end of file
+  bboxMin = sceneBounds.min;
+  bboxMax = sceneBounds.max;
+}
+
+std::vector<glm::mat4> getNodeInstanceMatrices(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Node &node)
+{
+  const auto instancingIt = node.extensions.find("EXT_mesh_gpu_instancing");
+  if (instancingIt == end(node.extensions)) {
+    return {};
+  }
+  const auto &attributes = instancingIt->second.Get("attributes");
+  // View of an attribute, invalid if absent
+  const auto attributeView = [&](const char *name, auto &view) {
+    const auto &accessorIdx = attributes.Get(name);
+    if (accessorIdx.IsInt() && accessorIdx.Get<int>() >= 0 &&
+        size_t(accessorIdx.Get<int>()) < model.accessors.size()) {
+      view = {model, buffers, model.accessors[accessorIdx.Get<int>()]};
+    }
+    return attributes.Has(name);
+  };
+  AccessorView<glm::vec3> translations;
+  AccessorView<glm::vec4> rotations; // x, y, z, w
+  AccessorView<glm::vec3> scales;
+  const auto hasTranslations = attributeView("TRANSLATION", translations);
+  const auto hasRotations = attributeView("ROTATION", rotations);
+  const auto hasScales = attributeView("SCALE", scales);
+  // All attributes have the instance count
+  size_t instanceCount = 0;
+  for (const auto size : {hasTranslations ? translations.size() : 0,
+           hasRotations ? rotations.size() : 0,
+           hasScales ? scales.size() : 0}) {
+    instanceCount = std::max(instanceCount, size);
+  }
+  if ((hasTranslations && translations.size() != instanceCount) ||
+      (hasRotations && rotations.size() != instanceCount) ||
+      (hasScales && scales.size() != instanceCount) || !instanceCount) {
+    std::cerr << "Warn: invalid EXT_mesh_gpu_instancing attributes of node \""
+              << node.name << "\", ignored" << std::endl;
+    return {};
+  }
+
+  std::vector<glm::mat4> instanceMatrices(instanceCount);
+  for (size_t instanceIdx = 0; instanceIdx < instanceCount; ++instanceIdx) {
+    glm::mat4 matrix(1);
+    if (hasTranslations) {
+      matrix = glm::translate(matrix, translations[instanceIdx]);
+    }
+    if (hasRotations) {
+      const auto r = rotations[instanceIdx];
+      matrix = matrix * glm::mat4_cast(glm::quat(r.w, r.x, r.y, r.z));
+    }
+    if (hasScales) {
+      matrix = glm::scale(matrix, scales[instanceIdx]);
+    }
+    instanceMatrices[instanceIdx] = matrix;
+  }
+  return instanceMatrices;
+}
+
+std::vector<uint32_t> getPrimitiveIndices(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Primitive &primitive,
+    size_t vertexCount)
+{
+  if (primitive.indices >= 0) {
+    return AccessorView<uint32_t>(
+        model, buffers, model.accessors[primitive.indices])
+        .decode();
+  }
+  std::vector<uint32_t> indices(vertexCount);
+  for (size_t i = 0; i < vertexCount; ++i) {
+    indices[i] = uint32_t(i);
+  }
+  return indices;
+}
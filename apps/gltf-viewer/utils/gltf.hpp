@@ -1,10 +1,431 @@
 #pragma once
 
+#include "mapped_file.hpp"
+
 #include <glm/glm.hpp>
 #include <tiny_gltf.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// A read-only range of bytes
+struct ByteSpan
+{
+  const unsigned char *data = nullptr;
+  size_t size = 0;
+};
+
+// Bytes of the buffers of a glTF model, indexed like model.buffers.
+// Data URI buffers are viewed in tinygltf::Buffer::data, but the BIN chunk of
+// a .glb file and external .bin files are not copied there: they are viewed in
+// place in memory mapped files (kept alive by this object) and their
+// tinygltf::Buffer::data stays empty.
+// Code reading buffer content must go through this structure.
+struct GltfBuffers
+{
+  std::vector<ByteSpan> buffers;
+  // Index in mappedFiles of the file viewed by each buffer, -1 if the buffer
+  // is viewed in tinygltf::Buffer::data
+  std::vector<int> bufferFiles;
+  std::vector<MappedFile> mappedFiles;
+  // Encoded (PNG, JPEG...) bytes of each image when its decoding has been
+  // deferred (tinygltf::Image::as_is is then true), empty span otherwise
+  std::vector<ByteSpan> encodedImages;
+
+  const unsigned char *data(int bufferIdx) const
+  {
+    return buffers[bufferIdx].data;
+  }
+};
+
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix);
 
-void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
\ No newline at end of file
+void computeSceneBounds(const tinygltf::Model &model,
+    const GltfBuffers &buffers, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
+
+// Number and type of the components of the elements decoded by an
+// AccessorView: float, uint32_t, glm vectors and matrices of them
+template <typename T> struct AccessorElementTraits
+{
+  using Component = T;
+  static constexpr int componentCount = 1;
+};
+
+template <glm::length_t L, typename S, glm::qualifier Q>
+struct AccessorElementTraits<glm::vec<L, S, Q>>
+{
+  using Component = S;
+  static constexpr int componentCount = L;
+};
+
+template <glm::length_t C, glm::length_t R, typename S, glm::qualifier Q>
+struct AccessorElementTraits<glm::mat<C, R, S, Q>>
+{
+  using Component = S;
+  static constexpr int componentCount = C * R;
+};
+
+// Read-only view of the elements of an accessor as T, without copying the
+// buffer data: components are converted from the component type of the
+// accessor when read, normalized integers being mapped to [0, 1] or [-1, 1]
+// for float elements, and sparse values replace the ones of the buffer view.
+// Missing components of T are zeros, extra components of the accessor are
+// ignored. decode converts all elements at once, with a loop specialized for
+// the component type of the accessor.
+template <typename T> class AccessorView
+{
+public:
+  using Component = typename AccessorElementTraits<T>::Component;
+  static constexpr int componentCount = AccessorElementTraits<T>::componentCount;
+
+  AccessorView() = default;
+
+  AccessorView(const tinygltf::Model &model, const GltfBuffers &buffers,
+      const tinygltf::Accessor &accessor);
+
+  // False if the accessor reads out of its buffers, the view is then empty
+  bool valid() const { return m_bValid; }
+
+  size_t size() const { return m_nCount; }
+
+  T operator[](size_t i) const;
+
+  // Decode all elements to out, of size() elements
+  void decode(T *out) const;
+
+  std::vector<T> decode() const
+  {
+    std::vector<T> elements(m_nCount);
+    decode(elements.data());
+    return elements;
+  }
+
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = T;
+
+    const_iterator(const AccessorView *view, size_t i) : m_pView(view), m_i(i)
+    {
+    }
+
+    T operator*() const { return (*m_pView)[m_i]; }
+
+    const_iterator &operator++()
+    {
+      ++m_i;
+      return *this;
+    }
+
+    bool operator==(const const_iterator &other) const
+    {
+      return m_i == other.m_i;
+    }
+
+    bool operator!=(const const_iterator &other) const
+    {
+      return m_i != other.m_i;
+    }
+
+  private:
+    const AccessorView *m_pView;
+    size_t m_i;
+  };
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, m_nCount); }
+
+private:
+  // Convert the first count components at src, of type Src
+  template <typename Src>
+  static void decodeComponents(
+      const unsigned char *src, int count, bool normalized, Component *out);
+
+  static void decodeElement(const unsigned char *src, int componentType,
+      int count, bool normalized, T &out);
+
+  template <typename Src> void decodeRange(T *out) const;
+
+  // Index of the sparse value of element i, -1 if none
+  int sparseValueIndex(size_t i) const;
+
+  bool m_bValid = false;
+  size_t m_nCount = 0;
+  const unsigned char *m_pData = nullptr; // nullptr: zeros
+  size_t m_nByteStride = 0;
+  int m_ComponentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  int m_nComponentCount = 0; // Of the accessor, read up to componentCount
+  bool m_bNormalized = false;
+
+  // Sparse indices, sorted, and tightly packed values
+  size_t m_nSparseCount = 0;
+  const unsigned char *m_pSparseIndices = nullptr;
+  int m_SparseIndexType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+  const unsigned char *m_pSparseValues = nullptr;
+};
+
+// Local matrices of the instances of a node with EXT_mesh_gpu_instancing, to
+// apply before the matrix of the node. Empty without the extension or if its
+// accessors are invalid.
+std::vector<glm::mat4> getNodeInstanceMatrices(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Node &node);
+
+// Elements of an index accessor, or 0, 1, 2... up to vertexCount for a
+// primitive without indices
+std::vector<uint32_t> getPrimitiveIndices(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Primitive &primitive,
+    size_t vertexCount);
+
+template <typename T>
+AccessorView<T>::AccessorView(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const tinygltf::Accessor &accessor)
+{
+  const auto componentSize =
+      size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType));
+  const auto accessorComponentCount =
+      tinygltf::GetNumComponentsInType(accessor.type);
+  if (componentSize == size_t(-1) || accessorComponentCount <= 0) {
+    return;
+  }
+  const auto elementSize = componentSize * accessorComponentCount;
+  // A range of a buffer view, checked against the view and the buffer
+  const auto viewRange = [&](int bufferViewIdx, size_t byteOffset,
+                             size_t byteSize) -> const unsigned char * {
+    if (bufferViewIdx < 0 ||
+        size_t(bufferViewIdx) >= model.bufferViews.size()) {
+      return nullptr;
+    }
+    const auto &bufferView = model.bufferViews[bufferViewIdx];
+    if (bufferView.buffer < 0 ||
+        size_t(bufferView.buffer) >= buffers.buffers.size()) {
+      return nullptr;
+    }
+    if (byteOffset + byteSize > bufferView.byteLength ||
+        bufferView.byteOffset + bufferView.byteLength >
+            buffers.buffers[bufferView.buffer].size) {
+      return nullptr;
+    }
+    return buffers.data(bufferView.buffer) + bufferView.byteOffset +
+           byteOffset;
+  };
+
+  if (accessor.bufferView >= 0 && accessor.count) {
+    if (size_t(accessor.bufferView) >= model.bufferViews.size()) {
+      return;
+    }
+    const auto &bufferView = model.bufferViews[accessor.bufferView];
+    m_nByteStride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+    m_pData = viewRange(accessor.bufferView, accessor.byteOffset,
+        m_nByteStride * (accessor.count - 1) + elementSize);
+    if (!m_pData) {
+      return;
+    }
+  }
+  if (accessor.sparse.isSparse && accessor.sparse.count > 0) {
+    const auto &sparse = accessor.sparse;
+    const auto indexSize =
+        size_t(tinygltf::GetComponentSizeInBytes(sparse.indices.componentType));
+    if (indexSize == size_t(-1)) {
+      m_pData = nullptr;
+      return;
+    }
+    m_nSparseCount = size_t(sparse.count);
+    m_SparseIndexType = sparse.indices.componentType;
+    m_pSparseIndices = viewRange(sparse.indices.bufferView,
+        size_t(sparse.indices.byteOffset), indexSize * m_nSparseCount);
+    m_pSparseValues = viewRange(sparse.values.bufferView,
+        size_t(sparse.values.byteOffset), elementSize * m_nSparseCount);
+    if (!m_pSparseIndices || !m_pSparseValues) {
+      m_pData = nullptr;
+      m_nSparseCount = 0;
+      return;
+    }
+  }
+  m_bValid = true;
+  m_nCount = accessor.count;
+  m_ComponentType = accessor.componentType;
+  m_nComponentCount = accessorComponentCount;
+  m_bNormalized = accessor.normalized;
+}
+
+template <typename T>
+template <typename Src>
+void AccessorView<T>::decodeComponents(
+    const unsigned char *src, int count, bool normalized, Component *out)
+{
+  for (int c = 0; c < count; ++c) {
+    Src value;
+    std::memcpy(&value, src + c * sizeof(Src), sizeof(Src));
+    if (std::is_floating_point<Component>::value && normalized &&
+        std::is_integral<Src>::value) {
+      // Signed values use the symmetric range, the minimum being clamped
+      out[c] = Component(std::max(
+          float(value) / float(std::numeric_limits<Src>::max()), -1.f));
+    } else {
+      out[c] = Component(value);
+    }
+  }
+}
+
+template <typename T>
+void AccessorView<T>::decodeElement(const unsigned char *src,
+    int componentType, int count, bool normalized, T &out)
+{
+  auto *components = reinterpret_cast<Component *>(&out);
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_BYTE:
+    decodeComponents<int8_t>(src, count, normalized, components);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    decodeComponents<uint8_t>(src, count, normalized, components);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_SHORT:
+    decodeComponents<int16_t>(src, count, normalized, components);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    decodeComponents<uint16_t>(src, count, normalized, components);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    decodeComponents<uint32_t>(src, count, normalized, components);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_FLOAT:
+    decodeComponents<float>(src, count, normalized, components);
+    break;
+  }
+}
+
+template <typename T> int AccessorView<T>::sparseValueIndex(size_t i) const
+{
+  // Indices are strictly increasing
+  size_t first = 0;
+  size_t last = m_nSparseCount;
+  while (first < last) {
+    const auto middle = (first + last) / 2;
+    uint32_t index = 0;
+    switch (m_SparseIndexType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      index = m_pSparseIndices[middle];
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      uint16_t index16;
+      std::memcpy(&index16, m_pSparseIndices + 2 * middle, sizeof(index16));
+      index = index16;
+      break;
+    default:
+      std::memcpy(&index, m_pSparseIndices + 4 * middle, sizeof(index));
+      break;
+    }
+    if (index == i) {
+      return int(middle);
+    }
+    if (index < i) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+  return -1;
+}
+
+template <typename T> T AccessorView<T>::operator[](size_t i) const
+{
+  T element{};
+  const auto count = std::min(m_nComponentCount, componentCount);
+  const auto sparseIdx = m_nSparseCount ? sparseValueIndex(i) : -1;
+  if (sparseIdx >= 0) {
+    const auto elementSize =
+        tinygltf::GetComponentSizeInBytes(m_ComponentType) * m_nComponentCount;
+    decodeElement(m_pSparseValues + sparseIdx * elementSize, m_ComponentType,
+        count, m_bNormalized, element);
+  } else if (m_pData) {
+    decodeElement(m_pData + i * m_nByteStride, m_ComponentType, count,
+        m_bNormalized, element);
+  }
+  return element;
+}
+
+template <typename T>
+template <typename Src>
+void AccessorView<T>::decodeRange(T *out) const
+{
+  const auto count = std::min(m_nComponentCount, componentCount);
+  if (std::is_same<Src, Component>::value && count == componentCount &&
+      m_nByteStride == sizeof(T)) {
+    // Same layout: a copy
+    std::memcpy(out, m_pData, m_nCount * sizeof(T));
+    return;
+  }
+  for (size_t i = 0; i < m_nCount; ++i) {
+    auto *components = reinterpret_cast<Component *>(out + i);
+    decodeComponents<Src>(
+        m_pData + i * m_nByteStride, count, m_bNormalized, components);
+    std::fill(components + count, components + componentCount, Component(0));
+  }
+}
+
+template <typename T> void AccessorView<T>::decode(T *out) const
+{
+  if (!m_pData) {
+    std::fill(out, out + m_nCount, T{});
+  } else {
+    switch (m_ComponentType) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      decodeRange<int8_t>(out);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      decodeRange<uint8_t>(out);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+      decodeRange<int16_t>(out);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      decodeRange<uint16_t>(out);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      decodeRange<uint32_t>(out);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+      decodeRange<float>(out);
+      break;
+    }
+  }
+  // Patch the sparse values, in a second pass
+  if (m_nSparseCount) {
+    const auto count = std::min(m_nComponentCount, componentCount);
+    const auto elementSize =
+        tinygltf::GetComponentSizeInBytes(m_ComponentType) * m_nComponentCount;
+    for (size_t sparseIdx = 0; sparseIdx < m_nSparseCount; ++sparseIdx) {
+      size_t index = 0;
+      switch (m_SparseIndexType) {
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        index = m_pSparseIndices[sparseIdx];
+        break;
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        uint16_t index16;
+        std::memcpy(&index16, m_pSparseIndices + 2 * sparseIdx, sizeof(index16));
+        index = index16;
+        break;
+      default:
+        uint32_t index32;
+        std::memcpy(&index32, m_pSparseIndices + 4 * sparseIdx, sizeof(index32));
+        index = index32;
+        break;
+      }
+      if (index < m_nCount) {
+        out[index] = T{};
+        decodeElement(m_pSparseValues + sparseIdx * elementSize,
+            m_ComponentType, count, m_bNormalized, out[index]);
+      }
+    }
+  }
+}
@@ -0,0 +1,414 @@
+#include "gltf_loader.hpp"
+#include "ktx2.hpp"
+
+#include <json.hpp>
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#glb-file-format-specification
+static const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942; // "BIN\0"
+static const size_t GLB_HEADER_SIZE = 12;
+static const size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+// One byte buffer given to tinygltf in place of a mapped buffer
+static const char *MAPPED_BUFFER_PLACEHOLDER_URI =
+    "data:application/octet-stream;base64,AA==";
+
+static uint32_t readUint32(const unsigned char *bytes)
+{
+  // glTF binary is little endian, like all the platforms we target
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+GltfContainer detectGltfContainer(const unsigned char *bytes, size_t size)
+{
+  if (size >= 4 && readUint32(bytes) == GLB_MAGIC) {
+    return GltfContainer::Binary;
+  }
+  size_t offset = 0;
+  // Skip UTF-8 BOM
+  if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+    offset = 3;
+  }
+  while (offset < size && std::isspace(bytes[offset])) {
+    ++offset;
+  }
+  if (offset < size && bytes[offset] == '{') {
+    return GltfContainer::Ascii;
+  }
+  return GltfContainer::Unknown;
+}
+
+static bool mappedReadWholeFile(std::vector<unsigned char> *out,
+    std::string *err, const std::string &filepath, void *)
+{
+  MappedFile file;
+  if (!file.open(filepath)) {
+    if (err) {
+      (*err) += "Unable to map file " + filepath + "\n";
+    }
+    return false;
+  }
+  out->assign(file.data(), file.data() + file.size());
+  return true;
+}
+
+tinygltf::FsCallbacks mappedFsCallbacks()
+{
+  return tinygltf::FsCallbacks{&tinygltf::FileExists,
+      &tinygltf::ExpandFilePath, &mappedReadWholeFile,
+      &tinygltf::WriteWholeFile, nullptr};
+}
+
+// Find an external file like tinygltf does, relatively to baseDir or to the
+// working directory
+static std::string findExternalFile(const tinygltf::FsCallbacks &callbacks,
+    const std::string &baseDir, const std::string &uri)
+{
+  for (const auto &dir : {fs::path(baseDir), fs::path(".")}) {
+    const auto path =
+        callbacks.ExpandFilePath((dir / uri).string(), callbacks.user_data);
+    if (callbacks.FileExists(path, callbacks.user_data)) {
+      return path;
+    }
+  }
+  return std::string();
+}
+
+// View each buffer in the tinygltf::Buffer::data filled by tinygltf
+static void viewBuffersInModel(
+    const tinygltf::Model &model, GltfBuffers &buffers)
+{
+  buffers.buffers.resize(model.buffers.size());
+  buffers.bufferFiles.assign(model.buffers.size(), -1);
+  for (size_t bufferIdx = 0; bufferIdx < model.buffers.size(); ++bufferIdx) {
+    const auto &data = model.buffers[bufferIdx].data;
+    buffers.buffers[bufferIdx] = ByteSpan{data.data(), data.size()};
+  }
+}
+
+// A buffer viewed in one of GltfBuffers::mappedFiles instead of being loaded
+// by tinygltf
+struct MappedBuffer
+{
+  ByteSpan bytes;
+  int mappedFile = -1; // -1 if the buffer is loaded by tinygltf
+};
+
+// State shared with loadImageData while tinygltf parses the document
+struct ImagesContext
+{
+  // Keep encoded bytes instead of decoding images, see loadGltf
+  bool deferDecoding = false;
+  // Encoded bytes of the images stored in a mapped buffer, indexed like
+  // model.images (empty span for other images)
+  std::vector<ByteSpan> imageBytes;
+  // Original bufferView of the images stored in a mapped buffer
+  std::vector<int> imageBufferViews;
+};
+
+// Images stored in a mapped buffer are given to tinygltf through a
+// placeholder bufferView, read them from the mapped file instead.
+static bool loadImageData(tinygltf::Image *image, const int imageIdx,
+    std::string *err, std::string *warn, int reqWidth, int reqHeight,
+    const unsigned char *bytes, int size, void *userData)
+{
+  const auto &context = *static_cast<const ImagesContext *>(userData);
+  const auto isMapped = size_t(imageIdx) < context.imageBytes.size() &&
+                        context.imageBytes[imageIdx].data;
+  if (isMapped) {
+    bytes = context.imageBytes[imageIdx].data;
+    size = int(context.imageBytes[imageIdx].size);
+  }
+  // KTX2 images are uploaded without decoding, see ImageDecoder
+  if (context.deferDecoding || isKtx2(bytes, size_t(size))) {
+    // Mapped bytes stay in place when deferring (see
+    // GltfBuffers::encodedImages), others are only valid during this call
+    image->as_is = true;
+    if (!isMapped || !context.deferDecoding) {
+      image->image.assign(bytes, bytes + size);
+    }
+    return true;
+  }
+  return tinygltf::LoadImageData(
+      image, imageIdx, err, warn, reqWidth, reqHeight, bytes, size, nullptr);
+}
+
+// Parse a glTF JSON document with tinygltf, except for the bytes of
+// mappedBuffers (indexed like the "buffers" array) that are viewed in place
+// instead of being copied in tinygltf::Buffer::data.
+static bool loadDocument(nlohmann::json &document,
+    const std::vector<MappedBuffer> &mappedBuffers, const std::string &baseDir,
+    bool deferImageDecoding, tinygltf::Model &model, GltfBuffers &buffers,
+    std::string &err, std::string &warn)
+{
+  const auto isMapped = [&](int bufferIdx) {
+    return bufferIdx >= 0 && size_t(bufferIdx) < mappedBuffers.size() &&
+           mappedBuffers[bufferIdx].mappedFile >= 0;
+  };
+
+  // tinygltf would copy mapped buffers in memory: replace them by a one byte
+  // placeholder, we view their bytes in place after parsing.
+  const auto buffersIt = document.find("buffers");
+  if (buffersIt != document.end() && buffersIt->is_array()) {
+    for (size_t bufferIdx = 0; bufferIdx < buffersIt->size(); ++bufferIdx) {
+      if (isMapped(int(bufferIdx))) {
+        auto &buffer = (*buffersIt)[bufferIdx];
+        buffer["uri"] = MAPPED_BUFFER_PLACEHOLDER_URI;
+        buffer["byteLength"] = 1;
+      }
+    }
+  }
+
+  // tinygltf reads images stored in a bufferView from tinygltf::Buffer::data,
+  // so point them to a placeholder bufferView and give the real bytes to our
+  // image loader.
+  ImagesContext context;
+  context.deferDecoding = deferImageDecoding;
+  int placeholderBufferViewIdx = -1;
+  const auto bufferViewsIt = document.find("bufferViews");
+  const auto imagesIt = document.find("images");
+  if (bufferViewsIt != document.end() && bufferViewsIt->is_array() &&
+      imagesIt != document.end() && imagesIt->is_array()) {
+    auto &bufferViews = *bufferViewsIt;
+    auto &images = *imagesIt;
+    context.imageBytes.resize(images.size());
+    context.imageBufferViews.resize(images.size(), -1);
+    for (size_t imageIdx = 0; imageIdx < images.size(); ++imageIdx) {
+      auto &image = images[imageIdx];
+      if (!image.is_object() || !image.count("bufferView")) {
+        continue;
+      }
+      const auto bufferViewIdx = image.value("bufferView", -1);
+      if (bufferViewIdx < 0 || size_t(bufferViewIdx) >= bufferViews.size()) {
+        continue; // Let tinygltf report the error
+      }
+      const auto &bufferView = bufferViews[bufferViewIdx];
+      const auto bufferIdx = bufferView.value("buffer", -1);
+      if (!isMapped(bufferIdx)) {
+        continue;
+      }
+      const auto &bytes = mappedBuffers[bufferIdx].bytes;
+      const auto byteOffset = bufferView.value("byteOffset", size_t(0));
+      const auto byteLength = bufferView.value("byteLength", size_t(0));
+      if (byteOffset + byteLength > bytes.size) {
+        err += "image[" + std::to_string(imageIdx) +
+               "] bufferView is out of its buffer.\n";
+        return false;
+      }
+      if (placeholderBufferViewIdx < 0) {
+        placeholderBufferViewIdx = int(bufferViews.size());
+        bufferViews.push_back(
+            {{"buffer", bufferIdx}, {"byteOffset", 0}, {"byteLength", 1}});
+      }
+      context.imageBytes[imageIdx] =
+          ByteSpan{bytes.data + byteOffset, byteLength};
+      context.imageBufferViews[imageIdx] = bufferViewIdx;
+      image["bufferView"] = placeholderBufferViewIdx;
+    }
+  }
+
+  tinygltf::TinyGLTF loader;
+  loader.SetFsCallbacks(mappedFsCallbacks());
+  loader.SetImageLoader(loadImageData, &context);
+  const auto json = document.dump();
+  if (!loader.LoadASCIIFromString(&model, &err, &warn, json.c_str(),
+          unsigned(json.size()), baseDir)) {
+    return false;
+  }
+
+  // Undo the placeholders
+  if (placeholderBufferViewIdx >= 0) {
+    model.bufferViews.resize(placeholderBufferViewIdx);
+  }
+  for (size_t imageIdx = 0; imageIdx < context.imageBufferViews.size();
+       ++imageIdx) {
+    if (context.imageBufferViews[imageIdx] >= 0) {
+      model.images[imageIdx].bufferView = context.imageBufferViews[imageIdx];
+    }
+  }
+  viewBuffersInModel(model, buffers);
+  for (size_t bufferIdx = 0; bufferIdx < model.buffers.size(); ++bufferIdx) {
+    if (isMapped(int(bufferIdx))) {
+      auto &buffer = model.buffers[bufferIdx];
+      buffer.uri.clear();
+      std::vector<unsigned char>().swap(buffer.data);
+      buffers.buffers[bufferIdx] = mappedBuffers[bufferIdx].bytes;
+      buffers.bufferFiles[bufferIdx] = mappedBuffers[bufferIdx].mappedFile;
+    }
+  }
+  buffers.encodedImages.assign(model.images.size(), ByteSpan{});
+  if (deferImageDecoding) {
+    for (size_t imageIdx = 0; imageIdx < model.images.size(); ++imageIdx) {
+      const auto &image = model.images[imageIdx];
+      if (!image.as_is) {
+        continue; // Not loaded, tinygltf gave a warning
+      }
+      buffers.encodedImages[imageIdx] =
+          imageIdx < context.imageBytes.size() &&
+                  context.imageBytes[imageIdx].data
+              ? context.imageBytes[imageIdx]
+              : ByteSpan{image.image.data(), image.image.size()};
+    }
+  }
+
+  return true;
+}
+
+static bool parseDocument(const unsigned char *bytes, size_t size,
+    nlohmann::json &document, std::string &err)
+{
+  const auto begin = reinterpret_cast<const char *>(bytes);
+  try {
+    document = nlohmann::json::parse(begin, begin + size);
+  } catch (const std::exception &e) {
+    err += e.what();
+    return false;
+  }
+  if (!document.is_object()) {
+    err += "Root element is not a JSON object\n";
+    return false;
+  }
+  return true;
+}
+
+static bool loadGlb(MappedFile &&file, const std::string &baseDir,
+    bool deferImageDecoding, tinygltf::Model &model, GltfBuffers &buffers, std::string &err,
+    std::string &warn)
+{
+  const auto bytes = file.data();
+  const auto size = file.size();
+
+  if (size < GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE) {
+    err += "Too short data size for glTF Binary.\n";
+    return false;
+  }
+  const auto version = readUint32(bytes + 4);
+  const size_t length = readUint32(bytes + 8);
+  const size_t jsonLength = readUint32(bytes + GLB_HEADER_SIZE);
+  const auto jsonFormat = readUint32(bytes + GLB_HEADER_SIZE + 4);
+  const size_t jsonOffset = GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE;
+  if (version != 2 || length > size || jsonFormat != GLB_CHUNK_JSON ||
+      jsonLength < 1 || jsonOffset + jsonLength > length) {
+    err += "Invalid glTF binary.\n";
+    return false;
+  }
+
+  // The BIN chunk is optional and must directly follow the JSON chunk
+  ByteSpan binChunk;
+  const size_t binHeaderOffset = jsonOffset + jsonLength;
+  if (binHeaderOffset + GLB_CHUNK_HEADER_SIZE <= length) {
+    const size_t binLength = readUint32(bytes + binHeaderOffset);
+    const auto binFormat = readUint32(bytes + binHeaderOffset + 4);
+    const size_t binOffset = binHeaderOffset + GLB_CHUNK_HEADER_SIZE;
+    if (binFormat == GLB_CHUNK_BIN && binOffset + binLength <= length) {
+      binChunk = ByteSpan{bytes + binOffset, binLength};
+    }
+  }
+
+  nlohmann::json document;
+  if (!parseDocument(bytes + jsonOffset, jsonLength, document, err)) {
+    return false;
+  }
+
+  // Buffers without uri are viewed in the BIN chunk
+  const auto mappedFileIdx = int(buffers.mappedFiles.size());
+  std::vector<MappedBuffer> mappedBuffers;
+  const auto buffersIt = document.find("buffers");
+  if (buffersIt != document.end() && buffersIt->is_array()) {
+    for (const auto &buffer : *buffersIt) {
+      mappedBuffers.emplace_back();
+      if (!binChunk.data || !buffer.is_object() || buffer.count("uri")) {
+        continue; // Without BIN chunk, let tinygltf report the error
+      }
+      const auto byteLength = buffer.value("byteLength", size_t(0));
+      if (byteLength > binChunk.size) {
+        std::stringstream ss;
+        ss << "Invalid `byteLength'. Must be equal or less than binary size: "
+              "`byteLength' = "
+           << byteLength << ", binary size = " << binChunk.size << std::endl;
+        err += ss.str();
+        return false;
+      }
+      mappedBuffers.back() =
+          MappedBuffer{ByteSpan{binChunk.data, byteLength}, mappedFileIdx};
+    }
+  }
+  buffers.mappedFiles.emplace_back(std::move(file));
+
+  return loadDocument(document, mappedBuffers, baseDir, deferImageDecoding,
+      model, buffers, err, warn);
+}
+
+static bool loadAscii(const MappedFile &file, const std::string &baseDir,
+    bool deferImageDecoding, tinygltf::Model &model, GltfBuffers &buffers, std::string &err,
+    std::string &warn)
+{
+  nlohmann::json document;
+  if (!parseDocument(file.data(), file.size(), document, err)) {
+    return false;
+  }
+
+  // Map external .bin files instead of letting tinygltf read them in memory
+  const auto callbacks = mappedFsCallbacks();
+  std::vector<MappedBuffer> mappedBuffers;
+  const auto buffersIt = document.find("buffers");
+  if (buffersIt != document.end() && buffersIt->is_array()) {
+    for (const auto &buffer : *buffersIt) {
+      mappedBuffers.emplace_back();
+      if (!buffer.is_object() || !buffer.count("uri")) {
+        continue;
+      }
+      const auto uri = buffer.value("uri", std::string());
+      if (uri.empty() || tinygltf::IsDataURI(uri)) {
+        continue;
+      }
+      const auto byteLength = buffer.value("byteLength", size_t(0));
+      const auto path = findExternalFile(callbacks, baseDir, uri);
+      MappedFile bufferFile;
+      if (path.empty() || !bufferFile.open(path) ||
+          bufferFile.size() < byteLength) {
+        continue; // Let tinygltf report the error
+      }
+      mappedBuffers.back() =
+          MappedBuffer{ByteSpan{bufferFile.data(), byteLength},
+              int(buffers.mappedFiles.size())};
+      buffers.mappedFiles.emplace_back(std::move(bufferFile));
+    }
+  }
+
+  return loadDocument(document, mappedBuffers, baseDir, deferImageDecoding,
+      model, buffers, err, warn);
+}
+
+bool loadGltf(const fs::path &path, tinygltf::Model &model,
+    GltfBuffers &buffers, std::string &err, std::string &warn,
+    bool deferImageDecoding)
+{
+  MappedFile file;
+  if (!file.open(path)) {
+    err += "Unable to open file " + path.string() + "\n";
+    return false;
+  }
+
+  const auto baseDir = path.parent_path().string();
+  switch (detectGltfContainer(file.data(), file.size())) {
+  case GltfContainer::Ascii:
+    return loadAscii(
+        file, baseDir, deferImageDecoding, model, buffers, err, warn);
+  case GltfContainer::Binary:
+    return loadGlb(std::move(file), baseDir, deferImageDecoding, model,
+        buffers, err, warn);
+  default:
+    break;
+  }
+  err += "Unrecognized glTF container for file " + path.string() + "\n";
+  return false;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gltf.hpp"
+
+#include <string>
+#include <tiny_gltf.h>
+
+enum class GltfContainer
+{
+  Unknown,
+  Ascii, // .gltf: a JSON document, buffers are data URIs or external files
+  Binary // .glb: a binary header followed by a JSON chunk and a BIN chunk
+};
+
+// Detect the container format of a glTF file from its first bytes, whatever
+// its extension: binary glTF starts with the "glTF" magic and ASCII glTF with
+// a JSON object.
+GltfContainer detectGltfContainer(const unsigned char *bytes, size_t size);
+
+// tinygltf filesystem callbacks reading files through memory mappings.
+// tinygltf requires ReadWholeFile to fill a std::vector, so files read through
+// these callbacks are still copied once (images, mostly). Buffers are not read
+// this way: loadGltf maps them and keeps the mappings in GltfBuffers.
+tinygltf::FsCallbacks mappedFsCallbacks();
+
+// Load a .gltf or .glb file. The file is memory mapped and the BIN chunk of a
+// .glb file, as well as external .bin files, are referenced in place by
+// buffers instead of being copied in tinygltf::Buffer::data.
+// If deferImageDecoding is true, images are not decoded: their encoded bytes
+// are exposed by buffers.encodedImages, for ImageDecoder.
+// Return false on failure, err and warn are filled with tinygltf messages.
+bool loadGltf(const fs::path &path, tinygltf::Model &model,
+    GltfBuffers &buffers, std::string &err, std::string &warn,
+    bool deferImageDecoding = false);
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "gpu_arena.hpp"
+
+#include <algorithm>
+
+GpuArena::GpuArena(size_t blockSize) : m_nBlockSize(blockSize) {}
+
+GpuArena::~GpuArena()
+{
+  for (const auto &block : m_Blocks) {
+    glDeleteBuffers(1, &block.bufferObject);
+  }
+}
+
+void GpuArena::reserve(size_t size)
+{
+  if (m_Blocks.empty() ||
+      alignedOffset(ALIGNMENT) + size > m_Blocks.back().size) {
+    createBlock(size);
+  }
+}
+
+GpuArena::Allocation GpuArena::allocate(size_t size, size_t alignment)
+{
+  if (m_Blocks.empty() ||
+      alignedOffset(alignment) + size > m_Blocks.back().size) {
+    createBlock(std::max(size, m_nBlockSize));
+  }
+  auto &block = m_Blocks.back();
+  const auto offset = alignedOffset(alignment);
+  block.usedSize = offset + size;
+  m_nAllocatedSize += size;
+  return Allocation{block.bufferObject, offset, size};
+}
+
+void GpuArena::upload(const Allocation &allocation, size_t offset,
+    const void *data, size_t size) const
+{
+  glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.bufferObject);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(allocation.offset + offset),
+      GLsizeiptr(size), data);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GpuArena::copy(const Allocation &src, size_t srcOffset,
+    const Allocation &dst, size_t dstOffset, size_t size)
+{
+  glBindBuffer(GL_COPY_READ_BUFFER, src.bufferObject);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, dst.bufferObject);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+      GLintptr(src.offset + srcOffset), GLintptr(dst.offset + dstOffset),
+      GLsizeiptr(size));
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+size_t GpuArena::alignedOffset(size_t alignment) const
+{
+  return (m_Blocks.back().usedSize + alignment - 1) & ~(alignment - 1);
+}
+
+void GpuArena::createBlock(size_t size)
+{
+  // At least one byte: a zero sized buffer cannot be bound
+  Block block{0, std::max(size, size_t(1)), 0};
+  glGenBuffers(1, &block.bufferObject);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, block.bufferObject);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, GLsizeiptr(block.size), nullptr,
+      GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  m_Blocks.push_back(block);
+  m_nReservedSize += block.size;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Sub-allocator of large immutable GL buffers for geometry. Allocations are
+// packed one after the other in the last block, a new block is created when
+// it is full. Callers knowing the total size of their allocations reserve it
+// first, so that blocks are not larger than needed. Nothing is freed before
+// the arena is destroyed, which fits geometry uploaded once at load time.
+class GpuArena
+{
+public:
+  // A range of a block
+  struct Allocation
+  {
+    GLuint bufferObject = 0;
+    size_t offset = 0;
+    size_t size = 0;
+  };
+
+  explicit GpuArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+  ~GpuArena();
+
+  // Non-copyable class:
+  GpuArena(const GpuArena &) = delete;
+  GpuArena &operator=(const GpuArena &) = delete;
+
+  // Make sure that size bytes can be allocated without creating a block,
+  // creating a block of exactly size bytes if needed. Allocations must
+  // include their alignment padding in size.
+  void reserve(size_t size);
+
+  // alignment must be a power of two. A block of blockSize bytes, or size if
+  // larger, is created if the last one is full.
+  Allocation allocate(size_t size, size_t alignment = ALIGNMENT);
+
+  // Copy size bytes to allocation at offset
+  void upload(const Allocation &allocation, size_t offset, const void *data,
+      size_t size) const;
+
+  // Copy size bytes from src at srcOffset to dst at dstOffset, on the GPU.
+  // The allocations can be of different arenas.
+  static void copy(const Allocation &src, size_t srcOffset,
+      const Allocation &dst, size_t dstOffset, size_t size);
+
+  size_t blockCount() const { return m_Blocks.size(); }
+
+  // Bytes allocated in all blocks, and bytes of all blocks
+  size_t allocatedSize() const { return m_nAllocatedSize; }
+  size_t reservedSize() const { return m_nReservedSize; }
+
+  static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+  // Default alignment, enough for any vertex attribute or index
+  static const size_t ALIGNMENT = 16;
+
+private:
+  struct Block
+  {
+    GLuint bufferObject;
+    size_t size;
+    size_t usedSize;
+  };
+
+  size_t alignedOffset(size_t alignment) const;
+
+  void createBlock(size_t size);
+
+  size_t m_nBlockSize;
+  std::vector<Block> m_Blocks;
+  size_t m_nAllocatedSize = 0;
+  size_t m_nReservedSize = 0;
+};
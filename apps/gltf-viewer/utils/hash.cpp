@@ -0,0 +1,32 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+uint64_t hashBytes(const unsigned char *bytes, size_t size, uint64_t seed)
+{
+  const uint64_t m = 0xc6a4a7935bd1e995ull;
+  const int r = 47;
+  uint64_t h = seed ^ (size * m);
+
+  const auto *end = bytes + size / 8 * 8;
+  for (const auto *p = bytes; p != end; p += 8) {
+    uint64_t k;
+    std::memcpy(&k, p, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  const auto tailSize = size % 8;
+  if (tailSize) {
+    uint64_t k = 0;
+    std::memcpy(&k, end, tailSize);
+    h ^= k;
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// MurmurHash64A of bytes, for the keys of cache entries. Not cryptographic.
+uint64_t hashBytes(const unsigned char *bytes, size_t size, uint64_t seed = 0);
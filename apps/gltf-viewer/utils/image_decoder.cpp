@@ -0,0 +1,177 @@
+#include "image_decoder.hpp"
+#include "ktx2.hpp"
+#include "mipmaps.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+ImageDecoder::ImageDecoder(tinygltf::Model &model, GltfBuffers &buffers,
+    const std::vector<int> &images, const std::vector<bool> &srgbImages,
+    const TextureCache *pCache, size_t threadCount) :
+    m_Model(model),
+    m_Buffers(buffers),
+    m_SrgbImages(srgbImages),
+    m_pCache(pCache),
+    m_CachedImages(model.images.size()),
+    m_nRemainingCount(images.size()),
+    m_ThreadPool(threadCount)
+{
+  m_SrgbImages.resize(model.images.size(), false);
+  m_Buffers.encodedImages.resize(model.images.size());
+
+  std::vector<size_t> pendingImages;
+  for (const size_t imageIdx : images) {
+    auto &image = model.images[imageIdx];
+    auto &encodedBytes = buffers.encodedImages[imageIdx];
+    if (!encodedBytes.data && image.as_is) {
+      // Kept as is by tinygltf (KTX2)
+      encodedBytes = ByteSpan{image.image.data(), image.image.size()};
+    }
+    if (encodedBytes.data || !image.image.empty()) {
+      pendingImages.emplace_back(imageIdx);
+    } else {
+      // Not loaded at all
+      m_DecodedImages.emplace_back(imageIdx, std::string());
+    }
+  }
+
+  // Largest first, so that workers don't end up waiting for a big image
+  // started last
+  const auto size = [&](size_t imageIdx) {
+    return std::max(buffers.encodedImages[imageIdx].size,
+        model.images[imageIdx].image.size());
+  };
+  std::sort(begin(pendingImages), end(pendingImages),
+      [&](size_t a, size_t b) { return size(a) > size(b); });
+  for (const auto imageIdx : pendingImages) {
+    m_ThreadPool.push([this, imageIdx]() { decode(imageIdx); });
+  }
+}
+
+int ImageDecoder::waitNext() { return next(true); }
+
+int ImageDecoder::tryNext() { return next(false); }
+
+bool ImageDecoder::takeCachedImage(int imageIdx, CachedImage &cachedImage)
+{
+  if (!m_CachedImages[imageIdx].file.isOpen()) {
+    return false;
+  }
+  cachedImage = std::move(m_CachedImages[imageIdx]);
+  return true;
+}
+
+bool ImageDecoder::finished() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_nRemainingCount == 0;
+}
+
+int ImageDecoder::next(bool wait)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  if (m_nRemainingCount == 0 || (!wait && m_DecodedImages.empty())) {
+    return -1;
+  }
+  m_ImageDecoded.wait(lock, [this]() { return !m_DecodedImages.empty(); });
+  const auto decoded = std::move(m_DecodedImages.front());
+  m_DecodedImages.pop_front();
+  --m_nRemainingCount;
+  lock.unlock();
+
+  if (!decoded.second.empty()) {
+    std::cerr << "Err: " << decoded.second << std::endl;
+  }
+  return int(decoded.first);
+}
+
+void ImageDecoder::decode(size_t imageIdx)
+{
+  auto &image = m_Model.images[imageIdx];
+  auto &encodedBytes = m_Buffers.encodedImages[imageIdx];
+  const auto srgb = m_SrgbImages[imageIdx];
+
+  // Decoded by tinygltf already (see loadGltf): only the mip chain is missing
+  if (!encodedBytes.data) {
+    generateMipmaps(image.image, image.width, image.height, image.component,
+        image.bits, srgb);
+    setDecoded(imageIdx, std::string());
+    return;
+  }
+
+  uint64_t cacheKey = 0;
+  if (m_pCache && !isKtx2(encodedBytes.data, encodedBytes.size)) {
+    cacheKey = TextureCache::key(encodedBytes.data, encodedBytes.size, srgb);
+    auto &cachedImage = m_CachedImages[imageIdx];
+    if (m_pCache->load(cacheKey, cachedImage)) {
+      encodedBytes = ByteSpan{};
+      std::vector<unsigned char>().swap(image.image);
+      image.as_is = false;
+      image.width = cachedImage.width;
+      image.height = cachedImage.height;
+      image.component = cachedImage.component;
+      image.bits = cachedImage.bits;
+      image.pixel_type = cachedImage.bits == 16
+                             ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+                             : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+      setDecoded(imageIdx, std::string());
+      return;
+    }
+  }
+
+  // Decode in a temporary: the encoded bytes might be in image.image
+  tinygltf::Image decoded;
+  decoded.name = image.name;
+  std::string err, warn;
+  bool decodingSucceeded = false;
+  Ktx2Image ktx2Image;
+  if (isKtx2(encodedBytes.data, encodedBytes.size)) {
+    decodingSucceeded =
+        parseKtx2(encodedBytes.data, encodedBytes.size, ktx2Image, err);
+    if (decodingSucceeded) {
+      decoded.width = int(ktx2Image.width);
+      decoded.height = int(ktx2Image.height);
+      decoded.image.assign(
+          encodedBytes.data, encodedBytes.data + encodedBytes.size);
+      decoded.as_is = true;
+    } else {
+      err = "Image " + std::to_string(imageIdx) + ": " + err;
+    }
+  } else {
+    decodingSucceeded =
+        tinygltf::LoadImageData(&decoded, int(imageIdx), &err, &warn, 0, 0,
+            encodedBytes.data, int(encodedBytes.size), nullptr);
+    if (decodingSucceeded) {
+      generateMipmaps(decoded.image, decoded.width, decoded.height,
+          decoded.component, decoded.bits, srgb);
+      if (m_pCache) {
+        m_pCache->store(cacheKey, decoded.width, decoded.height,
+            decoded.component, decoded.bits, decoded.image);
+      }
+    }
+  }
+
+  encodedBytes = ByteSpan{};
+  image.as_is = decoded.as_is;
+  if (decodingSucceeded) {
+    image.width = decoded.width;
+    image.height = decoded.height;
+    image.component = decoded.component;
+    image.bits = decoded.bits;
+    image.pixel_type = decoded.pixel_type;
+    image.image = std::move(decoded.image);
+  } else {
+    std::vector<unsigned char>().swap(image.image);
+  }
+
+  setDecoded(imageIdx, std::move(err));
+}
+
+void ImageDecoder::setDecoded(size_t imageIdx, std::string err)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_DecodedImages.emplace_back(imageIdx, std::move(err));
+  }
+  m_ImageDecoded.notify_one();
+}
\ No newline at end of file
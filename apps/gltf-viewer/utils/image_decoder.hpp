@@ -0,0 +1,79 @@
+#pragma once
+
+#include "gltf.hpp"
+#include "texture_cache.hpp"
+#include "thread_pool.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <tiny_gltf.h>
+
+// Decode the images of a model loaded with deferred image decoding (see
+// loadGltf) in parallel on a thread pool. Decoded images are returned in the
+// order they finish so that they can be uploaded while others are still being
+// decoded.
+// Decoded pixels replace the encoded bytes in tinygltf::Image::image, with the
+// same layout as tinygltf's default image loader (RGBA, 8 or 16 bits),
+// followed by the other levels of their mip chain (see generateMipmaps).
+// With a TextureCache, images decoded by a previous run are loaded from the
+// cache instead, see takeCachedImage.
+// KTX2 images are not decoded, their container is only validated (see
+// parseKtx2) and stored in tinygltf::Image::image with as_is set to true.
+class ImageDecoder
+{
+public:
+  // Decode the images of model.images whose indices are given. srgbImages,
+  // indexed like model.images, tells how to filter mipmaps. Decoding starts
+  // right away. model, buffers and pCache must outlive the decoder.
+  ImageDecoder(tinygltf::Model &model, GltfBuffers &buffers,
+      const std::vector<int> &images, const std::vector<bool> &srgbImages,
+      const TextureCache *pCache = nullptr, size_t threadCount = 0);
+
+  // Non-copyable class:
+  ImageDecoder(const ImageDecoder &) = delete;
+  ImageDecoder &operator=(const ImageDecoder &) = delete;
+
+  // Return the index in model.images of an image that has been decoded and
+  // not returned yet, blocking until one is available. Return -1 when all
+  // images have been returned.
+  // An image that cannot be decoded is returned with an empty
+  // tinygltf::Image::image, after printing the error.
+  int waitNext();
+
+  // Same as waitNext, but return -1 right away if no image is available yet
+  int tryNext();
+
+  // True when all images have been returned by waitNext or tryNext
+  bool finished() const;
+
+  // For an image returned by waitNext or tryNext, move its cache entry to
+  // cachedImage if it has been loaded from the cache. tinygltf::Image::image
+  // is empty in that case, other fields of tinygltf::Image are set.
+  bool takeCachedImage(int imageIdx, CachedImage &cachedImage);
+
+private:
+  int next(bool wait);
+
+  void decode(size_t imageIdx);
+
+  // Called by workers
+  void setDecoded(size_t imageIdx, std::string err);
+
+  tinygltf::Model &m_Model;
+  GltfBuffers &m_Buffers;
+  std::vector<bool> m_SrgbImages;
+  const TextureCache *m_pCache;
+  // Indexed like model.images, each written by one worker only
+  std::vector<CachedImage> m_CachedImages;
+
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_ImageDecoded;
+  std::deque<std::pair<size_t, std::string>> m_DecodedImages; // (idx, error)
+  size_t m_nRemainingCount = 0; // Images not returned by waitNext yet
+
+  // Last member: its destructor waits for the workers which use the members
+  // above
+  ThreadPool m_ThreadPool;
+};
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+
+// Queue of the current thread in the job system it works for: workers use
+// their own queue, other threads share queue 0
+static thread_local const JobSystem *t_pJobSystem = nullptr;
+static thread_local size_t t_QueueIdx = 0;
+
+JobSystem::JobSystem(size_t threadCount)
+{
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_Queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t queueIdx = 1; queueIdx < threadCount; ++queueIdx) {
+    m_Threads.emplace_back([this, queueIdx]() { workerLoop(queueIdx); });
+  }
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_SleepMutex);
+    m_bStopping = true;
+  }
+  m_JobAvailable.notify_all();
+  for (auto &thread : m_Threads) {
+    thread.join();
+  }
+}
+
+void JobSystem::dispatch(std::function<void()> job, Counter &counter)
+{
+  counter.m_nPendingJobs.fetch_add(1, std::memory_order_relaxed);
+  auto &queue = *m_Queues[t_pJobSystem == this ? t_QueueIdx : 0];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(Job{std::move(job), &counter});
+  }
+  // Incremented under the lock of sleeping workers so that no wake up is lost
+  {
+    std::lock_guard<std::mutex> lock(m_SleepMutex);
+    m_nQueuedJobs.fetch_add(1, std::memory_order_relaxed);
+  }
+  m_JobAvailable.notify_one();
+}
+
+bool JobSystem::runJob()
+{
+  const auto ownQueueIdx = t_pJobSystem == this ? t_QueueIdx : 0;
+  Job job;
+  bool found = false;
+  {
+    auto &queue = *m_Queues[ownQueueIdx];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+      found = true;
+    }
+  }
+  // Steal the oldest job of another queue, probably the largest part of its
+  // work left
+  for (size_t i = 1; !found && i < m_Queues.size(); ++i) {
+    auto &queue = *m_Queues[(ownQueueIdx + i) % m_Queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+      found = true;
+    }
+  }
+  if (!found) {
+    return false;
+  }
+  m_nQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+  job.function();
+  job.counter->m_nPendingJobs.fetch_sub(1, std::memory_order_release);
+  return true;
+}
+
+void JobSystem::wait(Counter &counter)
+{
+  while (!counter.done()) {
+    // The remaining jobs of counter are being executed by other threads
+    if (!runJob()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize,
+    const std::function<void(size_t, size_t)> &body)
+{
+  grainSize = std::max(grainSize, size_t(1));
+  if (count <= grainSize || m_Threads.empty()) {
+    if (count) {
+      body(0, count);
+    }
+    return;
+  }
+  Counter counter;
+  // The first range is executed by the calling thread while the others are
+  // stolen
+  for (size_t begin = grainSize; begin < count; begin += grainSize) {
+    const auto end = std::min(begin + grainSize, count);
+    dispatch([&body, begin, end]() { body(begin, end); }, counter);
+  }
+  body(0, grainSize);
+  wait(counter);
+}
+
+void JobSystem::workerLoop(size_t queueIdx)
+{
+  t_pJobSystem = this;
+  t_QueueIdx = queueIdx;
+  for (;;) {
+    if (runJob()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_SleepMutex);
+    m_JobAvailable.wait(lock, [this]() {
+      return m_bStopping || m_nQueuedJobs.load(std::memory_order_relaxed);
+    });
+    // Remaining jobs are still executed when stopping
+    if (m_bStopping && !m_nQueuedJobs.load(std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
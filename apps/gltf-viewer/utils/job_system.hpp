@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job system for short CPU jobs of a frame (animations, world
+// matrices). Each thread has its own queue: a thread pops the jobs it pushed
+// from the back, the most recent first, and steals from the front of the
+// queues of the other threads when its own is empty. The thread calling wait
+// executes jobs until its counter reaches zero, so it takes part in the work
+// and jobs can wait for jobs they dispatched.
+// Unlike ThreadPool, which runs long tasks (image decoding) in FIFO order
+// while the render thread goes on, it is meant to be waited within a frame.
+class JobSystem
+{
+public:
+  // Number of dispatched jobs not finished yet, waited as a fence
+  class Counter
+  {
+  public:
+    bool done() const
+    {
+      return m_nPendingJobs.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    friend class JobSystem;
+    std::atomic<size_t> m_nPendingJobs{0};
+  };
+
+  // threadCount includes the threads calling wait, and 0 means one thread per
+  // hardware thread: threadCount - 1 workers are started. With 1, jobs are
+  // executed by wait.
+  explicit JobSystem(size_t threadCount = 0);
+
+  ~JobSystem();
+
+  // Non-copyable class:
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  size_t threadCount() const { return m_Threads.size() + 1; }
+
+  void dispatch(std::function<void()> job, Counter &counter);
+
+  // Execute jobs until all the jobs of counter are finished
+  void wait(Counter &counter);
+
+  // Call body(begin, end) on ranges of at most grainSize indices covering
+  // [0, count), in parallel, and wait for them
+  void parallelFor(size_t count, size_t grainSize,
+      const std::function<void(size_t, size_t)> &body);
+
+private:
+  struct Job
+  {
+    std::function<void()> function;
+    Counter *counter;
+  };
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  // Run a job of the queue of the current thread, else steal one. False if
+  // all queues are empty.
+  bool runJob();
+
+  void workerLoop(size_t queueIdx);
+
+  // Queue 0 is shared by the threads that are not workers
+  std::vector<std::unique_ptr<Queue>> m_Queues;
+  std::vector<std::thread> m_Threads;
+  std::atomic<size_t> m_nQueuedJobs{0};
+  std::mutex m_SleepMutex;
+  std::condition_variable m_JobAvailable;
+  bool m_bStopping = false;
+};
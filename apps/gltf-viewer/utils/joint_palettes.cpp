@@ -0,0 +1,79 @@
+#include "joint_palettes.hpp"
+
+#include <iostream>
+
+JointPalettes::JointPalettes(const tinygltf::Model &model,
+    const GltfBuffers &buffers, const SceneGraph &sceneGraph) :
+    m_JointOffsets(sceneGraph.size(), -1),
+    m_Skins(sceneGraph.size(), -1)
+{
+  for (const auto &skin : model.skins) {
+    std::vector<int> jointFlatIndices;
+    for (const auto jointNodeIdx : skin.joints) {
+      jointFlatIndices.push_back(sceneGraph.flatIndex(jointNodeIdx));
+    }
+    // Identity matrices when not given
+    std::vector<glm::mat4> inverseBindMatrices(skin.joints.size(), glm::mat4(1));
+    if (skin.inverseBindMatrices >= 0) {
+      const AccessorView<glm::mat4> view(
+          model, buffers, model.accessors[skin.inverseBindMatrices]);
+      // The spec requires a matrix per joint, decode writes view.size()
+      if (view.valid() && view.size() == skin.joints.size()) {
+        view.decode(inverseBindMatrices.data());
+      } else {
+        std::cerr << "Warn: invalid inverse bind matrices of skin \""
+                  << skin.name << "\", ignored" << std::endl;
+      }
+    }
+    m_JointFlatIndices.push_back(std::move(jointFlatIndices));
+    m_InverseBindMatrices.push_back(std::move(inverseBindMatrices));
+  }
+
+  size_t jointCount = 0;
+  for (const auto flatIdx : sceneGraph.meshNodes()) {
+    const auto skin = model.nodes[sceneGraph.nodeIndex(flatIdx)].skin;
+    if (skin < 0 || size_t(skin) >= model.skins.size()) {
+      continue;
+    }
+    m_JointOffsets[flatIdx] = int32_t(jointCount);
+    m_Skins[flatIdx] = skin;
+    m_SkinnedNodes.push_back(flatIdx);
+    jointCount += model.skins[skin].joints.size();
+  }
+  m_JointMatrices.resize(jointCount);
+}
+
+void JointPalettes::update(const SceneGraph &sceneGraph)
+{
+  for (const auto flatIdx : m_SkinnedNodes) {
+    const auto inverseNodeMatrix = glm::inverse(sceneGraph.worldMatrix(flatIdx));
+    const auto &jointFlatIndices = m_JointFlatIndices[m_Skins[flatIdx]];
+    const auto &inverseBindMatrices = m_InverseBindMatrices[m_Skins[flatIdx]];
+    auto *jointMatrices = m_JointMatrices.data() + m_JointOffsets[flatIdx];
+    for (size_t jointIdx = 0; jointIdx < jointFlatIndices.size(); ++jointIdx) {
+      // Joints outside of the scene stay at the origin
+      const auto jointFlatIdx = jointFlatIndices[jointIdx];
+      const auto jointWorldMatrix = jointFlatIdx >= 0
+                                        ? sceneGraph.worldMatrix(jointFlatIdx)
+                                        : glm::mat4(1);
+      jointMatrices[jointIdx] =
+          inverseNodeMatrix * jointWorldMatrix * inverseBindMatrices[jointIdx];
+    }
+  }
+}
+
+Aabb JointPalettes::skinnedBounds(size_t flatIdx, const Aabb &localBounds,
+    const glm::mat4 &worldMatrix) const
+{
+  Aabb bounds;
+  const auto jointOffset = m_JointOffsets[flatIdx];
+  if (jointOffset < 0) {
+    return transformAabb(localBounds, worldMatrix);
+  }
+  const auto jointCount = m_JointFlatIndices[m_Skins[flatIdx]].size();
+  for (size_t jointIdx = 0; jointIdx < jointCount; ++jointIdx) {
+    bounds.extend(transformAabb(
+        localBounds, worldMatrix * m_JointMatrices[jointOffset + jointIdx]));
+  }
+  return bounds;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gltf.hpp"
+#include "scene_graph.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <vector>
+
+// Joint matrices of the skinned nodes of a scene, blended by forward.vs.glsl.
+// The palettes of all skinned nodes are packed in a single array, uploaded by
+// a single write per frame. A joint matrix maps a vertex in bind pose to the
+// local space of its skinned node, so that the model matrix of the node still
+// applies: inverse(world(node)) * world(joint) * inverseBindMatrix.
+class JointPalettes
+{
+public:
+  JointPalettes(const tinygltf::Model &model, const GltfBuffers &buffers,
+      const SceneGraph &sceneGraph);
+
+  // First joint matrix of a flat node, -1 if it is not skinned
+  int32_t jointOffset(size_t flatIdx) const { return m_JointOffsets[flatIdx]; }
+
+  size_t skinnedNodeCount() const { return m_SkinnedNodes.size(); }
+
+  // Recompute the joint matrices from the world matrices of sceneGraph
+  void update(const SceneGraph &sceneGraph);
+
+  const std::vector<glm::mat4> &jointMatrices() const
+  {
+    return m_JointMatrices;
+  }
+
+  // World bounds of the local bounds of a primitive of a skinned flat node,
+  // deformed by its skin: a skinned vertex is a convex combination of the
+  // vertex transformed by each joint, so it is in the union of the bounds
+  // transformed by each joint
+  Aabb skinnedBounds(size_t flatIdx, const Aabb &localBounds,
+      const glm::mat4 &worldMatrix) const;
+
+private:
+  // Indexed by flat node
+  std::vector<int32_t> m_JointOffsets;
+  std::vector<int> m_Skins; // -1 if not skinned
+  std::vector<size_t> m_SkinnedNodes; // Flat indices
+  // Per skin
+  std::vector<std::vector<int>> m_JointFlatIndices;
+  std::vector<std::vector<glm::mat4>> m_InverseBindMatrices;
+  std::vector<glm::mat4> m_JointMatrices;
+};
@@ -0,0 +1,159 @@
+#include "ktx2.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// EXT_texture_compression_s3tc and EXT_texture_sRGB, not in our GL loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+static const unsigned char KTX2_IDENTIFIER[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const size_t KTX2_HEADER_SIZE = 80;
+static const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+struct Ktx2VkFormat
+{
+  uint32_t vkFormat;
+  Ktx2Format format;
+};
+
+// VkFormat values of the formats we can upload as is. Both the UNORM and SRGB
+// variants of a format map to the same entry: the color space of a texture
+// is given by its use in materials.
+static const Ktx2VkFormat KTX2_FORMATS[] = {
+    {131, {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,
+              8}},
+    {132, {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,
+              8}},
+    {133, {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+              GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 8}},
+    {134, {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+              GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 8}},
+    {135, {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+              GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 16}},
+    {136, {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+              GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 16}},
+    {137, {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+              GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16}},
+    {138, {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+              GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16}},
+    {139, {GL_COMPRESSED_RED_RGTC1, 0, 8}},
+    {140, {GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 8}},
+    {141, {GL_COMPRESSED_RG_RGTC2, 0, 16}},
+    {142, {GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 16}},
+    {143, {GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 0, 16}},
+    {144, {GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 0, 16}},
+    {145, {GL_COMPRESSED_RGBA_BPTC_UNORM, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,
+              16}},
+    {146, {GL_COMPRESSED_RGBA_BPTC_UNORM, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,
+              16}},
+    {147, {GL_COMPRESSED_RGB8_ETC2, GL_COMPRESSED_SRGB8_ETC2, 8}},
+    {148, {GL_COMPRESSED_RGB8_ETC2, GL_COMPRESSED_SRGB8_ETC2, 8}},
+    {149, {GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+              GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 8}},
+    {150, {GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+              GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 8}},
+    {151, {GL_COMPRESSED_RGBA8_ETC2_EAC, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC,
+              16}},
+    {152, {GL_COMPRESSED_RGBA8_ETC2_EAC, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC,
+              16}},
+    {153, {GL_COMPRESSED_R11_EAC, 0, 8}},
+    {154, {GL_COMPRESSED_SIGNED_R11_EAC, 0, 8}},
+    {155, {GL_COMPRESSED_RG11_EAC, 0, 16}},
+    {156, {GL_COMPRESSED_SIGNED_RG11_EAC, 0, 16}},
+};
+
+template <typename T> static T readLittleEndian(const unsigned char *bytes)
+{
+  // KTX2 is little endian, like all the platforms we target
+  T value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+bool isKtx2(const unsigned char *bytes, size_t size)
+{
+  return size >= sizeof(KTX2_IDENTIFIER) &&
+         std::memcmp(bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+bool parseKtx2(const unsigned char *bytes, size_t size, Ktx2Image &image,
+    std::string &err)
+{
+  if (!isKtx2(bytes, size) || size < KTX2_HEADER_SIZE) {
+    err = "Not a KTX2 file";
+    return false;
+  }
+  const auto vkFormat = readLittleEndian<uint32_t>(bytes + 12);
+  const auto width = readLittleEndian<uint32_t>(bytes + 20);
+  const auto height = readLittleEndian<uint32_t>(bytes + 24);
+  const auto depth = readLittleEndian<uint32_t>(bytes + 28);
+  const auto layerCount = readLittleEndian<uint32_t>(bytes + 32);
+  const auto faceCount = readLittleEndian<uint32_t>(bytes + 36);
+  // 0 means that mipmaps should be generated, only possible when decoded
+  const auto levelCount = std::max(1u, readLittleEndian<uint32_t>(bytes + 40));
+  const auto supercompressionScheme = readLittleEndian<uint32_t>(bytes + 44);
+
+  if (vkFormat == 0) {
+    err = "Basis Universal KTX2 images are not supported";
+    return false;
+  }
+  if (supercompressionScheme != 0) {
+    err = "Supercompressed KTX2 images are not supported";
+    return false;
+  }
+  if (width == 0 || height == 0 || depth > 1 || layerCount > 1 ||
+      faceCount != 1) {
+    err = "Only 2D KTX2 images are supported";
+    return false;
+  }
+  const Ktx2Format *pFormat = nullptr;
+  for (const auto &format : KTX2_FORMATS) {
+    if (format.vkFormat == vkFormat) {
+      pFormat = &format.format;
+    }
+  }
+  if (!pFormat) {
+    err = "Unsupported KTX2 format " + std::to_string(vkFormat);
+    return false;
+  }
+  if (levelCount > 32 ||
+      size < KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE) {
+    err = "Invalid KTX2 level index";
+    return false;
+  }
+
+  image.format = *pFormat;
+  image.width = width;
+  image.height = height;
+  image.levels.clear();
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    const auto *entry =
+        bytes + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+    const auto byteOffset = readLittleEndian<uint64_t>(entry);
+    const auto byteLength = readLittleEndian<uint64_t>(entry + 8);
+
+    const auto levelWidth = std::max(1u, width >> level);
+    const auto levelHeight = std::max(1u, height >> level);
+    const auto expectedLength = uint64_t((levelWidth + 3) / 4) *
+                                ((levelHeight + 3) / 4) * pFormat->blockSize;
+    if (byteOffset > size || byteLength > size - byteOffset ||
+        byteLength < expectedLength) {
+      err = "Invalid KTX2 level " + std::to_string(level);
+      return false;
+    }
+    image.levels.push_back(ByteSpan{bytes + byteOffset, size_t(byteLength)});
+  }
+  return true;
+}
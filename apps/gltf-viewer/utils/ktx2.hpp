@@ -0,0 +1,35 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// Block compressed OpenGL format of a KTX2 image
+struct Ktx2Format
+{
+  GLenum linearFormat = 0;
+  GLenum srgbFormat = 0; // 0 if the format has no sRGB variant
+  size_t blockSize = 0; // Bytes per 4x4 block
+};
+
+// A KTX2 image viewed in place in its container
+struct Ktx2Image
+{
+  Ktx2Format format;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<ByteSpan> levels; // Largest first
+};
+
+// https://github.khronos.org/KTX-Specification/
+bool isKtx2(const unsigned char *bytes, size_t size);
+
+// Parse a KTX2 container holding a 2D texture in a BCn or ETC2/EAC format.
+// Basis Universal payloads (the usual content of KHR_texture_basisu images)
+// and supercompressed levels would need a transcoder and are rejected.
+// Return false and fill err on failure.
+bool parseKtx2(const unsigned char *bytes, size_t size, Ktx2Image &image,
+    std::string &err);
@@ -0,0 +1,138 @@
+#include "lod_cache.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+static const char LOD_CACHE_MAGIC[4] = {'G', 'V', 'L', 'C'};
+// To be incremented when the format or the simplification changes
+static const uint32_t LOD_CACHE_VERSION = 1;
+
+struct LodCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t lodCount;
+};
+
+// Followed by the indices of each level, in order
+struct LodCacheLevel
+{
+  uint32_t indexCount;
+  float error;
+};
+
+LodCache::LodCache(fs::path directory) : m_Directory(std::move(directory))
+{
+  try {
+    fs::create_directories(m_Directory);
+  } catch (const fs::filesystem_error &) {
+    // Entries will fail to be stored
+  }
+}
+
+uint64_t LodCache::key(const glm::vec3 *positions, size_t vertexCount,
+    const std::vector<uint32_t> &indices, size_t maxLodCount)
+{
+  const auto positionHash =
+      hashBytes((const unsigned char *)positions,
+          vertexCount * sizeof(glm::vec3), LOD_CACHE_VERSION + maxLodCount);
+  return hashBytes((const unsigned char *)indices.data(),
+      indices.size() * sizeof(uint32_t), positionHash);
+}
+
+bool LodCache::load(
+    uint64_t key, size_t vertexCount, std::vector<MeshLod> &lods) const
+{
+  MappedFile file;
+  if (!file.open(entryPath(key))) {
+    return false;
+  }
+  LodCacheHeader header;
+  if (file.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, LOD_CACHE_MAGIC, sizeof(header.magic)) ||
+      header.version != LOD_CACHE_VERSION ||
+      file.size() - sizeof(header) < header.lodCount * sizeof(LodCacheLevel)) {
+    return false;
+  }
+  size_t offset = sizeof(header) + header.lodCount * sizeof(LodCacheLevel);
+  std::vector<MeshLod> entryLods(header.lodCount);
+  for (uint32_t lodIdx = 0; lodIdx < header.lodCount; ++lodIdx) {
+    LodCacheLevel level;
+    std::memcpy(&level,
+        file.data() + sizeof(header) + lodIdx * sizeof(LodCacheLevel),
+        sizeof(level));
+    const auto byteSize = size_t(level.indexCount) * sizeof(uint32_t);
+    if (file.size() - offset < byteSize) {
+      return false;
+    }
+    auto &lod = entryLods[lodIdx];
+    lod.error = level.error;
+    lod.indices.resize(level.indexCount);
+    std::memcpy(lod.indices.data(), file.data() + offset, byteSize);
+    offset += byteSize;
+    // Indices are checked since they are not hashed
+    for (const auto index : lod.indices) {
+      if (index >= vertexCount) {
+        return false;
+      }
+    }
+  }
+  lods = std::move(entryLods);
+  return true;
+}
+
+void LodCache::store(uint64_t key, const std::vector<MeshLod> &lods) const
+{
+  LodCacheHeader header;
+  std::memcpy(header.magic, LOD_CACHE_MAGIC, sizeof(header.magic));
+  header.version = LOD_CACHE_VERSION;
+  header.lodCount = uint32_t(lods.size());
+
+  // Write a temporary file then rename it, so that a concurrent or
+  // interrupted run never sees a partial entry
+  const auto path = entryPath(key);
+  auto tmpPath = path;
+  tmpPath += ".tmp" + std::to_string(std::hash<std::thread::id>()(
+                          std::this_thread::get_id()));
+  bool written;
+  {
+    std::ofstream file(tmpPath.string(), std::ios::binary);
+    file.write((const char *)&header, sizeof(header));
+    for (const auto &lod : lods) {
+      const LodCacheLevel level{uint32_t(lod.indices.size()), lod.error};
+      file.write((const char *)&level, sizeof(level));
+    }
+    for (const auto &lod : lods) {
+      file.write((const char *)lod.indices.data(),
+          lod.indices.size() * sizeof(uint32_t));
+    }
+    file.close();
+    written = bool(file);
+  }
+  try {
+    if (written) {
+      fs::rename(tmpPath, path);
+    } else {
+      fs::remove(tmpPath);
+    }
+  } catch (const fs::filesystem_error &) {
+  }
+}
+
+fs::path LodCache::entryPath(uint64_t key) const
+{
+  std::stringstream ss;
+  ss << std::hex;
+  ss.width(16);
+  ss.fill('0');
+  ss << key;
+  return m_Directory / (ss.str() + ".lod");
+}
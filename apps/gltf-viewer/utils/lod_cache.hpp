@@ -0,0 +1,38 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "simplify.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Persistent cache of the levels of detail of meshes (see buildLodChain), so
+// that large meshes are only simplified by the first run. Entries are files of
+// the cache directory named after a hash of the positions and indices of the
+// mesh.
+// load and store can be called concurrently from several threads.
+class LodCache
+{
+public:
+  // The directory is created if needed
+  explicit LodCache(fs::path directory);
+
+  // Key of the levels of a mesh, built with at most maxLodCount levels
+  static uint64_t key(const glm::vec3 *positions, size_t vertexCount,
+      const std::vector<uint32_t> &indices, size_t maxLodCount);
+
+  // Read the entry of key, for a mesh of vertexCount vertices. Return false if
+  // there is no valid entry.
+  bool load(uint64_t key, size_t vertexCount, std::vector<MeshLod> &lods) const;
+
+  // Write the entry of key. Failures are not reported, the entry is just
+  // missing next time.
+  void store(uint64_t key, const std::vector<MeshLod> &lods) const;
+
+private:
+  fs::path entryPath(uint64_t key) const;
+
+  fs::path m_Directory;
+};
@@ -0,0 +1,153 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <utility>
+
+MappedFile::MappedFile(MappedFile &&rvalue)
+{
+  *this = std::move(rvalue);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&rvalue)
+{
+  if (this != &rvalue) {
+    close();
+    std::swap(m_pData, rvalue.m_pData);
+    std::swap(m_nSize, rvalue.m_nSize);
+#ifdef _WIN32
+    std::swap(m_hFile, rvalue.m_hFile);
+    std::swap(m_hMapping, rvalue.m_hMapping);
+#endif
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const fs::path &path)
+{
+  close();
+
+  const auto hFile = CreateFileW(path.wstring().c_str(), GENERIC_READ,
+      FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (hFile == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  m_hFile = hFile;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+    close();
+    return false;
+  }
+
+  m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_hMapping) {
+    close();
+    return false;
+  }
+
+  m_pData = static_cast<const unsigned char *>(
+      MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+  if (!m_pData) {
+    close();
+    return false;
+  }
+  m_nSize = size_t(fileSize.QuadPart);
+
+  return true;
+}
+
+void MappedFile::discard(const unsigned char *begin, size_t size) const
+{
+  // Unlocking pages that are not locked removes them from the working set
+  VirtualUnlock(const_cast<unsigned char *>(begin), size);
+}
+
+void MappedFile::close()
+{
+  if (m_pData) {
+    UnmapViewOfFile(m_pData);
+  }
+  if (m_hMapping) {
+    CloseHandle(m_hMapping);
+  }
+  if (m_hFile) {
+    CloseHandle(m_hFile);
+  }
+  m_pData = nullptr;
+  m_nSize = 0;
+  m_hMapping = nullptr;
+  m_hFile = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const fs::path &path)
+{
+  close();
+
+  const auto fd = ::open(path.string().c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  const auto size = size_t(fileStat.st_size);
+  void *pData = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference on the file
+  ::close(fd);
+  if (pData == MAP_FAILED) {
+    return false;
+  }
+
+  // Buffers are mostly read front to back, let the kernel read ahead
+  madvise(pData, size, MADV_SEQUENTIAL);
+
+  m_pData = static_cast<const unsigned char *>(pData);
+  m_nSize = size;
+
+  return true;
+}
+
+void MappedFile::discard(const unsigned char *begin, size_t size) const
+{
+  // Only whole pages can be dropped
+  const auto pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+  const auto first = (uintptr_t(begin) + pageSize - 1) & ~(pageSize - 1);
+  const auto last = (uintptr_t(begin) + size) & ~(pageSize - 1);
+  if (first < last) {
+    // The mapping is private and read-only: dropped pages are clean and are
+    // just read again from the file
+    madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED);
+  }
+}
+
+void MappedFile::close()
+{
+  if (m_pData) {
+    munmap(const_cast<unsigned char *>(m_pData), m_nSize);
+  }
+  m_pData = nullptr;
+  m_nSize = 0;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are only read from disk when
+// they are touched, and the mapping is released when the object is destroyed.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+
+  ~MappedFile() { close(); }
+
+  // Non-copyable class:
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&rvalue);
+  MappedFile &operator=(MappedFile &&rvalue);
+
+  // Map the file at path, return false if it cannot be opened or mapped
+  bool open(const fs::path &path);
+
+  void close();
+
+  bool isOpen() const { return m_pData != nullptr; }
+
+  const unsigned char *data() const { return m_pData; }
+
+  size_t size() const { return m_nSize; }
+
+  // Drop the pages of [begin, begin + size) from resident memory once they
+  // are not needed anymore. They are read again from disk if touched later.
+  void discard(const unsigned char *begin, size_t size) const;
+
+private:
+  const unsigned char *m_pData = nullptr;
+  size_t m_nSize = 0;
+#ifdef _WIN32
+  void *m_hFile = nullptr;
+  void *m_hMapping = nullptr;
+#endif
+};
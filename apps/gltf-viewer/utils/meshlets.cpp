@@ -0,0 +1,160 @@
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Bounds of the triangles of meshlet
+static void computeMeshletBounds(Meshlet &meshlet, const uint32_t *indices,
+    const glm::vec3 *positions)
+{
+  const auto *triangles = indices + meshlet.firstIndex;
+  const auto indexCount = size_t(meshlet.triangleCount) * 3;
+
+  // Sphere around the bounding box
+  glm::vec3 boundsMin(std::numeric_limits<float>::max());
+  glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < indexCount; ++i) {
+    boundsMin = glm::min(boundsMin, positions[triangles[i]]);
+    boundsMax = glm::max(boundsMax, positions[triangles[i]]);
+  }
+  meshlet.center = 0.5f * (boundsMin + boundsMax);
+  float squaredRadius = 0.f;
+  for (size_t i = 0; i < indexCount; ++i) {
+    const auto offset = positions[triangles[i]] - meshlet.center;
+    squaredRadius = std::max(squaredRadius, glm::dot(offset, offset));
+  }
+  meshlet.radius = std::sqrt(squaredRadius);
+
+  // Cone around the mean normal, degenerate triangles have none
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.triangleCount);
+  glm::vec3 normalSum(0.f);
+  for (size_t i = 0; i < indexCount; i += 3) {
+    const auto &p0 = positions[triangles[i]];
+    const auto normal = glm::cross(
+        positions[triangles[i + 1]] - p0, positions[triangles[i + 2]] - p0);
+    const auto length = glm::length(normal);
+    if (length > 0.f) {
+      normals.push_back(normal / length);
+      normalSum += normals.back();
+    }
+  }
+  const auto normalSumLength = glm::length(normalSum);
+  meshlet.coneAxis =
+      normalSumLength > 0.f ? normalSum / normalSumLength : glm::vec3(0.f);
+  meshlet.coneCutoff = 1.f;
+  if (normals.empty() || normalSumLength <= 0.f) {
+    return;
+  }
+  auto minDot = 1.f;
+  for (const auto &normal : normals) {
+    minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normal));
+  }
+  // Sine of the half angle of the cone, once rotated by 90 degrees: the
+  // cluster is backfacing if the view direction is outside of it
+  if (minDot > 0.f) {
+    meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+  }
+}
+
+std::vector<Meshlet> buildMeshlets(const uint32_t *indices, size_t indexCount,
+    const glm::vec3 *positions, size_t vertexCount, size_t maxVertexCount,
+    size_t maxTriangleCount)
+{
+  std::vector<Meshlet> meshlets;
+  // Meshlet of the last triangle using each vertex, to count unique vertices
+  const auto noMeshlet = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> vertexMeshlets(vertexCount, noMeshlet);
+  size_t meshletVertexCount = 0;
+  for (size_t i = 0; i + 2 < indexCount; i += 3) {
+    size_t newVertexCount = 0;
+    if (!meshlets.empty()) {
+      const auto meshletIdx = uint32_t(meshlets.size() - 1);
+      for (int c = 0; c < 3; ++c) {
+        newVertexCount += vertexMeshlets[indices[i + c]] != meshletIdx;
+      }
+    }
+    // A triangle that does not fit starts a new meshlet
+    if (meshlets.empty() ||
+        meshlets.back().triangleCount >= maxTriangleCount ||
+        meshletVertexCount + newVertexCount > maxVertexCount) {
+      Meshlet meshlet;
+      meshlet.firstIndex = uint32_t(i);
+      meshlet.triangleCount = 0;
+      meshlets.push_back(meshlet);
+      meshletVertexCount = 0;
+    }
+    const auto meshletIdx = uint32_t(meshlets.size() - 1);
+    for (int c = 0; c < 3; ++c) {
+      auto &vertexMeshlet = vertexMeshlets[indices[i + c]];
+      if (vertexMeshlet != meshletIdx) {
+        vertexMeshlet = meshletIdx;
+        ++meshletVertexCount;
+      }
+    }
+    ++meshlets.back().triangleCount;
+  }
+  for (auto &meshlet : meshlets) {
+    computeMeshletBounds(meshlet, indices, positions);
+  }
+  return meshlets;
+}
+
+void MeshletBounds::push(const Meshlet &meshlet)
+{
+  centerX.push_back(meshlet.center.x);
+  centerY.push_back(meshlet.center.y);
+  centerZ.push_back(meshlet.center.z);
+  radius.push_back(meshlet.radius);
+  coneAxisX.push_back(meshlet.coneAxis.x);
+  coneAxisY.push_back(meshlet.coneAxis.y);
+  coneAxisZ.push_back(meshlet.coneAxis.z);
+  coneCutoff.push_back(meshlet.coneCutoff);
+}
+
+void cullMeshlets(const MeshletBounds &bounds, size_t first, size_t count,
+    const glm::vec4 planes[6], const glm::vec3 &eye, bool cullBackfacing,
+    uint8_t *visible)
+{
+  const auto *centerX = bounds.centerX.data() + first;
+  const auto *centerY = bounds.centerY.data() + first;
+  const auto *centerZ = bounds.centerZ.data() + first;
+  const auto *radius = bounds.radius.data() + first;
+  const auto *coneAxisX = bounds.coneAxisX.data() + first;
+  const auto *coneAxisY = bounds.coneAxisY.data() + first;
+  const auto *coneAxisZ = bounds.coneAxisZ.data() + first;
+  const auto *coneCutoff = bounds.coneCutoff.data() + first;
+  // Plain arrays and no branches nor square roots, for the compiler to
+  // vectorize the loop
+  const int backfacingMask = cullBackfacing ? 1 : 0;
+  const auto plane0 = planes[0], plane1 = planes[1], plane2 = planes[2];
+  const auto plane3 = planes[3], plane4 = planes[4], plane5 = planes[5];
+  const auto planeDistance = [](const glm::vec4 &plane, float x, float y,
+                                 float z) {
+    return plane.x * x + plane.y * y + plane.z * z + plane.w;
+  };
+  for (size_t i = 0; i < count; ++i) {
+    const auto x = centerX[i];
+    const auto y = centerY[i];
+    const auto z = centerZ[i];
+    const auto r = -radius[i];
+    const int inside = (planeDistance(plane0, x, y, z) >= r) &
+                       (planeDistance(plane1, x, y, z) >= r) &
+                       (planeDistance(plane2, x, y, z) >= r) &
+                       (planeDistance(plane3, x, y, z) >= r) &
+                       (planeDistance(plane4, x, y, z) >= r) &
+                       (planeDistance(plane5, x, y, z) >= r);
+    // dot(d, axis) >= cutoff * |d| + radius, squared
+    const auto dx = x - eye.x;
+    const auto dy = y - eye.y;
+    const auto dz = z - eye.z;
+    const auto margin =
+        dx * coneAxisX[i] + dy * coneAxisY[i] + dz * coneAxisZ[i] + r;
+    const auto cutoff = coneCutoff[i];
+    const int backfacing =
+        (margin >= 0.f) &
+        (margin * margin >= cutoff * cutoff * (dx * dx + dy * dy + dz * dz));
+    visible[i] |= uint8_t(inside & (1 - (backfacing & backfacingMask)));
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A cluster of consecutive triangles of a triangle list, with bounds to cull
+// it as a whole
+struct Meshlet
+{
+  uint32_t firstIndex; // In the triangle list
+  uint32_t triangleCount;
+  // Bounding sphere
+  glm::vec3 center;
+  float radius;
+  // Cone of the normals of the triangles: the cluster faces away from any
+  // point p such that dot(center - p, coneAxis) >= coneCutoff * |center - p|
+  // + radius. coneCutoff is 1 if the normals are too spread out.
+  glm::vec3 coneAxis;
+  float coneCutoff;
+};
+
+// Split a triangle list into meshlets of at most maxVertexCount vertices and
+// maxTriangleCount triangles, in order: triangles should be ordered for
+// locality first, see optimizeVertexCache
+std::vector<Meshlet> buildMeshlets(const uint32_t *indices, size_t indexCount,
+    const glm::vec3 *positions, size_t vertexCount, size_t maxVertexCount = 64,
+    size_t maxTriangleCount = 124);
+
+// Bounds of meshlets as a structure of arrays, culled by vectorized loops
+struct MeshletBounds
+{
+  std::vector<float> centerX, centerY, centerZ, radius;
+  std::vector<float> coneAxisX, coneAxisY, coneAxisZ, coneCutoff;
+
+  size_t size() const { return radius.size(); }
+
+  void push(const Meshlet &meshlet);
+};
+
+// Set visible[i] to 1 for the meshlets first + i of bounds that intersect
+// planes and, if cullBackfacing, do not face away from eye. Planes and eye are
+// in the space of the meshlets, planes are normalized. Other values of
+// visible are unchanged, so that the meshlets of several instances can be
+// culled together.
+void cullMeshlets(const MeshletBounds &bounds, size_t first, size_t count,
+    const glm::vec4 planes[6], const glm::vec3 &eye, bool cullBackfacing,
+    uint8_t *visible);
@@ -0,0 +1,113 @@
+#include "mipmaps.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+static float srgbToLinear(float value)
+{
+  return value <= 0.04045f ? value / 12.92f
+                           : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value)
+{
+  return value <= 0.0031308f ? value * 12.92f
+                             : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+static float toLinear(uint8_t value)
+{
+  static const auto table = []() {
+    std::array<float, 256> table;
+    for (size_t i = 0; i < table.size(); ++i) {
+      table[i] = srgbToLinear(i / 255.f);
+    }
+    return table;
+  }();
+  return table[value];
+}
+
+static float toLinear(uint16_t value) { return srgbToLinear(value / 65535.f); }
+
+template <typename T>
+static void downsample(const T *src, int srcWidth, int srcHeight, T *dst,
+    int component, bool srgb)
+{
+  const auto maxValue = float(std::numeric_limits<T>::max());
+  const auto dstWidth = std::max(1, srcWidth / 2);
+  const auto dstHeight = std::max(1, srcHeight / 2);
+  const auto colorComponentCount = srgb && component >= 3 ? 3 : 0;
+
+  for (int y = 0; y < dstHeight; ++y) {
+    // Odd sizes: the last row and column are dropped
+    const auto rowSize = size_t(srcWidth) * component;
+    const T *rows[2] = {src + size_t(2 * y) * rowSize,
+        src + size_t(std::min(2 * y + 1, srcHeight - 1)) * rowSize};
+    for (int x = 0; x < dstWidth; ++x) {
+      const size_t columns[2] = {size_t(2 * x) * component,
+          size_t(std::min(2 * x + 1, srcWidth - 1)) * component};
+      auto *pixel = dst + (size_t(y) * dstWidth + x) * component;
+      for (int c = 0; c < component; ++c) {
+        const T values[4] = {rows[0][columns[0] + c], rows[0][columns[1] + c],
+            rows[1][columns[0] + c], rows[1][columns[1] + c]};
+        if (c < colorComponentCount) {
+          float linear = 0.f;
+          for (const auto value : values) {
+            linear += 0.25f * toLinear(value);
+          }
+          pixel[c] = T(std::lround(linearToSrgb(linear) * maxValue));
+        } else {
+          uint32_t sum = 2; // Round to nearest
+          for (const auto value : values) {
+            sum += value;
+          }
+          pixel[c] = T(sum / 4);
+        }
+      }
+    }
+  }
+}
+
+int mipLevelCount(int width, int height)
+{
+  return 1 + int(std::floor(std::log2(std::max(1, std::max(width, height)))));
+}
+
+size_t mipLevelSize(int width, int height, int level, int component, int bits)
+{
+  return size_t(std::max(1, width >> level)) * std::max(1, height >> level) *
+         component * (bits / 8);
+}
+
+size_t mipChainSize(int width, int height, int component, int bits)
+{
+  size_t size = 0;
+  for (int level = 0; level < mipLevelCount(width, height); ++level) {
+    size += mipLevelSize(width, height, level, component, bits);
+  }
+  return size;
+}
+
+void generateMipmaps(std::vector<unsigned char> &pixels, int width, int height,
+    int component, int bits, bool srgb)
+{
+  size_t srcOffset = 0;
+  pixels.resize(mipChainSize(width, height, component, bits));
+  for (int level = 1; level < mipLevelCount(width, height); ++level) {
+    const auto srcWidth = std::max(1, width >> (level - 1));
+    const auto srcHeight = std::max(1, height >> (level - 1));
+    const auto dstOffset =
+        srcOffset + mipLevelSize(width, height, level - 1, component, bits);
+    if (bits == 16) {
+      downsample((const uint16_t *)(pixels.data() + srcOffset), srcWidth,
+          srcHeight, (uint16_t *)(pixels.data() + dstOffset), component, srgb);
+    } else {
+      downsample(pixels.data() + srcOffset, srcWidth, srcHeight,
+          pixels.data() + dstOffset, component, srgb);
+    }
+    srcOffset = dstOffset;
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Number of levels of a full mip chain
+int mipLevelCount(int width, int height);
+
+// Size in bytes of a tightly packed mip level
+size_t mipLevelSize(int width, int height, int level, int component, int bits);
+
+// Size in bytes of the tightly packed levels of a full mip chain
+size_t mipChainSize(int width, int height, int component, int bits);
+
+// pixels holds level 0 of an image (8 or 16 bits per component). Append the
+// other levels of its full mip chain, computed with a box filter. If srgb is
+// true, the color components (not alpha) of images with at least three
+// components are filtered in linear space.
+void generateMipmaps(std::vector<unsigned char> &pixels, int width, int height,
+    int component, int bits, bool srgb);
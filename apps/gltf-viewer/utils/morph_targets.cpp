@@ -0,0 +1,75 @@
+#include "morph_targets.hpp"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+
+// Target attributes, in the order of the deltas of a vertex
+static const char *const MORPH_ATTRIBUTES[MorphTargets::DELTAS_PER_VERTEX] = {
+    "POSITION", "NORMAL", "TANGENT"};
+
+MorphTargets::MorphTargets(
+    const tinygltf::Model &model, const GltfBuffers &buffers)
+{
+  std::vector<glm::vec4> deltas;
+  std::vector<glm::vec3> targetDeltas;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      Primitive morphPrimitive;
+      const auto positionIt = primitive.attributes.find("POSITION");
+      if (primitive.targets.empty() ||
+          positionIt == end(primitive.attributes)) {
+        m_Primitives.push_back(morphPrimitive);
+        continue;
+      }
+      const auto vertexCount = model.accessors[positionIt->second].count;
+      const auto targetCount = primitive.targets.size();
+      morphPrimitive.firstDelta = GLuint(deltas.size());
+      morphPrimitive.targetCount = GLuint(targetCount);
+      deltas.resize(
+          deltas.size() + vertexCount * targetCount * DELTAS_PER_VERTEX,
+          glm::vec4(0.f));
+      auto *primitiveDeltas = deltas.data() + morphPrimitive.firstDelta;
+      for (size_t targetIdx = 0; targetIdx < targetCount; ++targetIdx) {
+        const auto &target = primitive.targets[targetIdx];
+        for (GLuint attributeIdx = 0; attributeIdx < DELTAS_PER_VERTEX;
+             ++attributeIdx) {
+          const auto it = target.find(MORPH_ATTRIBUTES[attributeIdx]);
+          if (it == end(target)) {
+            continue;
+          }
+          const AccessorView<glm::vec3> view(
+              model, buffers, model.accessors[it->second]);
+          if (!view.valid() || view.size() < vertexCount) {
+            std::cerr << "Warn: invalid morph target "
+                      << MORPH_ATTRIBUTES[attributeIdx]
+                      << " accessor, ignored" << std::endl;
+            continue;
+          }
+          targetDeltas.resize(view.size());
+          view.decode(targetDeltas.data());
+          for (size_t vertexIdx = 0; vertexIdx < vertexCount; ++vertexIdx) {
+            primitiveDeltas[(vertexIdx * targetCount + targetIdx) *
+                                DELTAS_PER_VERTEX +
+                            attributeIdx] =
+                glm::vec4(targetDeltas[vertexIdx], 0.f);
+          }
+        }
+      }
+      m_Primitives.push_back(morphPrimitive);
+    }
+  }
+
+  // At least one delta: a zero sized buffer cannot be bound
+  if (deltas.empty()) {
+    deltas.emplace_back(0.f);
+  }
+  m_nByteSize = deltas.size() * sizeof(glm::vec4);
+  glGenBuffers(1, &m_BufferObject);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+  glBufferStorage(
+      GL_COPY_WRITE_BUFFER, GLsizeiptr(m_nByteSize), deltas.data(), 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+MorphTargets::~MorphTargets() { glDeleteBuffers(1, &m_BufferObject); }
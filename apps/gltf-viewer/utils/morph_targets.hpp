@@ -0,0 +1,51 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <glad/glad.h>
+#include <tiny_gltf.h>
+
+#include <vector>
+
+// Morph target deltas of the primitives of a model, in a shader storage buffer
+// blended by forward.vs.glsl. Each vertex has DELTAS_PER_VERTEX deltas
+// (position, normal, tangent, as vec4 with w unused) per target, and the
+// deltas of a vertex are consecutive: the deltas of target t for vertex v of a
+// primitive start at firstDelta + (v * targetCount + t) * DELTAS_PER_VERTEX.
+// Sparse target accessors are densified here, once.
+class MorphTargets
+{
+public:
+  struct Primitive
+  {
+    GLuint firstDelta = 0; // In vec4
+    GLuint targetCount = 0;
+  };
+
+  MorphTargets(const tinygltf::Model &model, const GltfBuffers &buffers);
+
+  ~MorphTargets();
+
+  // Non-copyable class:
+  MorphTargets(const MorphTargets &) = delete;
+  MorphTargets &operator=(const MorphTargets &) = delete;
+
+  // Primitives of each mesh, in order: indexed like the VAOs of
+  // ViewerApplication::createVertexArrayObjects
+  const Primitive &primitive(size_t primitiveIdx) const
+  {
+    return m_Primitives[primitiveIdx];
+  }
+
+  // Never 0, even without targets, so that it can always be bound
+  GLuint bufferObject() const { return m_BufferObject; }
+
+  size_t byteSize() const { return m_nByteSize; }
+
+  static const GLuint DELTAS_PER_VERTEX = 3;
+
+private:
+  std::vector<Primitive> m_Primitives;
+  GLuint m_BufferObject = 0;
+  size_t m_nByteSize = 0;
+};
@@ -0,0 +1,52 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+uint64_t RenderQueue::makeKey(GLuint program, int material,
+    GLuint vertexArrayObject, size_t primitive, float depth)
+{
+  const auto clampedDepth = std::min(std::max(depth, 0.f), 1.f);
+  const auto quantizedDepth = uint64_t(std::lround(clampedDepth * 0xFFF));
+  // material is -1 for the default material
+  return (uint64_t(program & 0xFF) << 56) |
+         (uint64_t(uint32_t(material + 1) & 0xFFFF) << 40) |
+         (uint64_t(vertexArrayObject & 0xFFF) << 28) |
+         (uint64_t(primitive & 0xFFFF) << 12) | quantizedDepth;
+}
+
+void RenderQueue::clear()
+{
+  m_Items.clear();
+  m_SortedItems.clear();
+}
+
+void RenderQueue::push(const DrawItem &item, uint64_t key)
+{
+  m_SortedItems.emplace_back(key, uint32_t(m_Items.size()));
+  m_Items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+  // Pairs are small: cheaper to move around than the items themselves
+  std::sort(begin(m_SortedItems), end(m_SortedItems));
+}
+
+size_t RenderQueue::instanceRunEnd(size_t i) const
+{
+  const auto &first = (*this)[i];
+  for (++i; i < m_SortedItems.size(); ++i) {
+    const auto &item = (*this)[i];
+    if (item.program != first.program || item.material != first.material ||
+        item.vertexArrayObject != first.vertexArrayObject ||
+        item.mode != first.mode || item.count != first.count ||
+        item.indexType != first.indexType ||
+        item.indexByteOffset != first.indexByteOffset ||
+        item.baseVertex != first.baseVertex ||
+        item.multiDraw != first.multiDraw) {
+      break;
+    }
+  }
+  return i;
+}
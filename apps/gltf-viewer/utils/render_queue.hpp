@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Everything needed to submit the draw call of a primitive
+struct DrawItem
+{
+  GLuint program = 0;
+  GLuint vertexArrayObject = 0;
+  int material = -1; // Index in model.materials
+  int node = -1; // Flat index in the SceneGraph, for the matrices
+  // Index of the (node, primitive) pair of the scene drawn, for per draw data
+  // such as bounds
+  int sceneDraw = -1;
+  GLenum mode = GL_TRIANGLES;
+  GLsizei count = 0; // Indices if indexType is not 0, vertices otherwise
+  GLenum indexType = 0;
+  size_t indexByteOffset = 0; // In the element array buffer of the VAO
+  GLint baseVertex = 0;
+  // Geometry in a GeometryBatch: consecutive items with the same state can be
+  // submitted by a single multi-draw indirect call
+  bool multiDraw = false;
+};
+
+// Layout of the commands of glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// Draw items of a frame, sorted by a 64 bits key packing the render state so
+// that consecutive items share as much state as possible:
+//   program (8) | material (16) | VAO (12) | primitive (16) | depth (12 bits)
+// Items drawing the same primitive with the same state are consecutive, and
+// drawn as instances of a single draw. They are sorted front to back to help
+// early depth rejection. Fields wider than their bits are truncated, which
+// only makes the order less optimal: submission compares the actual state of
+// items.
+class RenderQueue
+{
+public:
+  // depth is normalized in [0, 1], 0 being the closest to the camera.
+  // primitive identifies the geometry drawn, in the VAO.
+  static uint64_t makeKey(GLuint program, int material,
+      GLuint vertexArrayObject, size_t primitive, float depth);
+
+  void clear();
+
+  void push(const DrawItem &item, uint64_t key);
+
+  void sort();
+
+  size_t size() const { return m_Items.size(); }
+
+  // i-th item in sorted order, valid after sort
+  const DrawItem &operator[](size_t i) const
+  {
+    return m_Items[m_SortedItems[i].second];
+  }
+
+  // End of the run of sorted items starting at i that only differ by their
+  // node and scene draw: they can be drawn as instances of a single draw
+  size_t instanceRunEnd(size_t i) const;
+
+private:
+  std::vector<DrawItem> m_Items; // Push order
+  std::vector<std::pair<uint64_t, uint32_t>> m_SortedItems; // (key, item)
+};
@@ -0,0 +1,127 @@
+#include "scene_graph.hpp"
+#include "gltf.hpp"
+#include "job_system.hpp"
+
+#include <iostream>
+#include <utility>
+
+SceneGraph::SceneGraph(const tinygltf::Model &model, int sceneIdx) :
+    m_FlatIndices(model.nodes.size(), -1)
+{
+  if (sceneIdx < 0) {
+    return;
+  }
+  // Depth-first traversal with an explicit stack of (node, flat parent).
+  // Roots and children are pushed in reverse to keep the glTF order.
+  std::vector<std::pair<int, int>> stack;
+  const auto &rootNodes = model.scenes[sceneIdx].nodes;
+  for (auto it = rootNodes.rbegin(); it != rootNodes.rend(); ++it) {
+    stack.emplace_back(*it, -1);
+  }
+  while (!stack.empty()) {
+    const auto nodeIdx = stack.back().first;
+    const auto parentIdx = stack.back().second;
+    stack.pop_back();
+    if (nodeIdx < 0 || nodeIdx >= int(model.nodes.size())) {
+      std::cerr << "Warn: invalid node index " << nodeIdx << ", skipping it"
+                << std::endl;
+      continue;
+    }
+    if (m_FlatIndices[nodeIdx] >= 0) {
+      // glTF nodes have at most one parent, and there is no cycle
+      std::cerr << "Warn: node " << nodeIdx
+                << " is reachable several times, skipping it" << std::endl;
+      continue;
+    }
+
+    const auto &node = model.nodes[nodeIdx];
+    const auto flatIdx = int(m_NodeIndices.size());
+    m_FlatIndices[nodeIdx] = flatIdx;
+    m_NodeIndices.push_back(nodeIdx);
+    m_Parents.push_back(parentIdx);
+    m_Meshes.push_back(node.mesh);
+    m_LocalMatrices.push_back(getLocalToWorldMatrix(node, glm::mat4(1)));
+    if (node.mesh >= 0) {
+      m_MeshNodes.push_back(flatIdx);
+    }
+    for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+      stack.emplace_back(*it, flatIdx);
+    }
+  }
+
+  // Nodes sorted by depth, by a counting sort: parents are before their
+  // children, so depths are final when children are visited
+  std::vector<uint32_t> depths(m_NodeIndices.size(), 0);
+  for (size_t flatIdx = 0; flatIdx < m_NodeIndices.size(); ++flatIdx) {
+    const auto parentIdx = m_Parents[flatIdx];
+    depths[flatIdx] = parentIdx >= 0 ? depths[parentIdx] + 1 : 0;
+    if (depths[flatIdx] + 2 > m_LevelOffsets.size()) {
+      m_LevelOffsets.resize(depths[flatIdx] + 2, 0);
+    }
+    ++m_LevelOffsets[depths[flatIdx] + 1];
+  }
+  for (size_t level = 1; level < m_LevelOffsets.size(); ++level) {
+    m_LevelOffsets[level] += m_LevelOffsets[level - 1];
+  }
+  m_LevelNodes.resize(m_NodeIndices.size());
+  auto levelEnds = m_LevelOffsets;
+  for (size_t flatIdx = 0; flatIdx < m_NodeIndices.size(); ++flatIdx) {
+    m_LevelNodes[levelEnds[depths[flatIdx]]++] = uint32_t(flatIdx);
+  }
+
+  m_WorldMatrices.resize(m_NodeIndices.size());
+  m_Dirty.assign(m_NodeIndices.size(), 1);
+  m_bAnyDirty = true;
+  updateWorldMatrices();
+}
+
+void SceneGraph::setLocalMatrix(size_t flatIdx, const glm::mat4 &localMatrix)
+{
+  m_LocalMatrices[flatIdx] = localMatrix;
+  m_Dirty[flatIdx] = 1;
+  m_bAnyDirty = true;
+}
+
+void SceneGraph::updateWorldMatrix(size_t flatIdx)
+{
+  const auto parentIdx = m_Parents[flatIdx];
+  if (parentIdx >= 0 && m_Dirty[parentIdx]) {
+    m_Dirty[flatIdx] = 1;
+  }
+  if (m_Dirty[flatIdx]) {
+    m_WorldMatrices[flatIdx] =
+        parentIdx >= 0 ? m_WorldMatrices[parentIdx] * m_LocalMatrices[flatIdx]
+                       : m_LocalMatrices[flatIdx];
+  }
+}
+
+bool SceneGraph::updateWorldMatrices(JobSystem *jobSystem)
+{
+  if (!m_bAnyDirty) {
+    return false;
+  }
+  if (jobSystem && jobSystem->threadCount() > 1 &&
+      m_NodeIndices.size() > PARALLEL_GRAIN_SIZE) {
+    // Nodes of a level only read the world matrices and dirty flags of the
+    // previous levels: a level is updated in parallel, then the next one
+    for (size_t level = 0; level + 1 < m_LevelOffsets.size(); ++level) {
+      const auto *levelNodes = m_LevelNodes.data() + m_LevelOffsets[level];
+      jobSystem->parallelFor(m_LevelOffsets[level + 1] - m_LevelOffsets[level],
+          PARALLEL_GRAIN_SIZE, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+              updateWorldMatrix(levelNodes[i]);
+            }
+          });
+    }
+  } else {
+    // Parents come first: their dirty flag and world matrix are final when
+    // their children are visited
+    for (size_t flatIdx = 0; flatIdx < m_NodeIndices.size(); ++flatIdx) {
+      updateWorldMatrix(flatIdx);
+    }
+  }
+  // Flags are cleared in a second pass since children read their parent's
+  m_Dirty.assign(m_Dirty.size(), 0);
+  m_bAnyDirty = false;
+  return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Flattened node hierarchy of a glTF scene, stored as parallel arrays indexed
+// by a "flat index". Nodes are sorted so that a parent always comes before its
+// children (depth-first, a subtree is contiguous), so world matrices are
+// computed by a single linear pass instead of a recursive traversal.
+// Local matrices are set through setLocalMatrix, which marks the node dirty:
+// updateWorldMatrices only recomputes the dirty nodes and their descendants,
+// so a static scene costs nothing per frame. With a JobSystem, the nodes of
+// each depth level are updated in parallel.
+class SceneGraph
+{
+public:
+  SceneGraph() = default;
+
+  // Flatten the nodes reachable from model.scenes[sceneIdx]. An empty graph is
+  // built if sceneIdx is -1.
+  SceneGraph(const tinygltf::Model &model, int sceneIdx);
+
+  size_t size() const { return m_NodeIndices.size(); }
+
+  // Index in model.nodes of a flat node
+  int nodeIndex(size_t flatIdx) const { return m_NodeIndices[flatIdx]; }
+
+  // Flat index of the parent, -1 for a root
+  int parent(size_t flatIdx) const { return m_Parents[flatIdx]; }
+
+  // Index in model.meshes, -1 if the node has no mesh
+  int mesh(size_t flatIdx) const { return m_Meshes[flatIdx]; }
+
+  // Flat index of model.nodes[nodeIdx], -1 if it is not in the scene
+  int flatIndex(int nodeIdx) const { return m_FlatIndices[nodeIdx]; }
+
+  // Flat indices of the nodes with a mesh, in increasing order
+  const std::vector<int> &meshNodes() const { return m_MeshNodes; }
+
+  const glm::mat4 &localMatrix(size_t flatIdx) const
+  {
+    return m_LocalMatrices[flatIdx];
+  }
+
+  void setLocalMatrix(size_t flatIdx, const glm::mat4 &localMatrix);
+
+  // Valid after updateWorldMatrices
+  const glm::mat4 &worldMatrix(size_t flatIdx) const
+  {
+    return m_WorldMatrices[flatIdx];
+  }
+
+  const std::vector<glm::mat4> &worldMatrices() const
+  {
+    return m_WorldMatrices;
+  }
+
+  // Recompute the world matrices of dirty nodes and of their descendants.
+  // Return true if any world matrix changed.
+  bool updateWorldMatrices(JobSystem *jobSystem = nullptr);
+
+private:
+  void updateWorldMatrix(size_t flatIdx);
+
+  // Nodes per job of a parallel update
+  static const size_t PARALLEL_GRAIN_SIZE = 256;
+
+  std::vector<int> m_NodeIndices;
+  std::vector<int> m_Parents;
+  std::vector<int> m_Meshes;
+  std::vector<glm::mat4> m_LocalMatrices;
+  std::vector<glm::mat4> m_WorldMatrices;
+  std::vector<uint8_t> m_Dirty; // uint8_t rather than packed bits
+  bool m_bAnyDirty = false;
+
+  std::vector<int> m_FlatIndices; // Indexed like model.nodes
+  std::vector<int> m_MeshNodes;
+  // Flat nodes sorted by depth, the nodes of depth d being in
+  // [m_LevelOffsets[d], m_LevelOffsets[d + 1])
+  std::vector<uint32_t> m_LevelNodes;
+  std::vector<size_t> m_LevelOffsets;
+};
@@ -0,0 +1,51 @@
+#include "shader_blocks.hpp"
+
+std::vector<MaterialBlock> getMaterialBlocks(
+    const tinygltf::Model &model, const TextureStreamer &textureStreamer)
+{
+  // Factors of missing textures are neutralized, like their textures: white
+  // base color, no metallic, roughness, emission or occlusion
+  MaterialBlock defaultMaterial;
+  defaultMaterial.baseColorFactor = glm::vec4(1);
+  defaultMaterial.emissiveFactor = glm::vec4(0);
+  defaultMaterial.metallicFactor = 0.f;
+  defaultMaterial.roughnessFactor = 0.f;
+  defaultMaterial.occlusionStrength = 0.f;
+  defaultMaterial.normalMapScale = 1.f;
+  defaultMaterial.hasNormalMap = 0;
+
+  std::vector<MaterialBlock> materialBlocks(
+      model.materials.size() + 1, defaultMaterial);
+  for (size_t materialIdx = 0; materialIdx < model.materials.size();
+       ++materialIdx) {
+    const auto &material = model.materials[materialIdx];
+    const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+    auto &materialBlock = materialBlocks[materialIdx];
+    if (pbrMetallicRoughness.baseColorTexture.index >= 0) {
+      const auto &factor = pbrMetallicRoughness.baseColorFactor;
+      materialBlock.baseColorFactor = glm::vec4(float(factor[0]),
+          float(factor[1]), float(factor[2]), float(factor[3]));
+    }
+    if (pbrMetallicRoughness.metallicRoughnessTexture.index >= 0) {
+      materialBlock.metallicFactor = float(pbrMetallicRoughness.metallicFactor);
+      materialBlock.roughnessFactor =
+          float(pbrMetallicRoughness.roughnessFactor);
+    }
+    if (material.emissiveTexture.index >= 0) {
+      const auto &factor = material.emissiveFactor;
+      materialBlock.emissiveFactor = glm::vec4(
+          float(factor[0]), float(factor[1]), float(factor[2]), 0.f);
+    }
+    if (material.occlusionTexture.index >= 0) {
+      materialBlock.occlusionStrength =
+          float(material.occlusionTexture.strength);
+    }
+    // A placeholder is not a valid normal map
+    if (material.normalTexture.index >= 0 &&
+        textureStreamer.textureObject(material.normalTexture.index)) {
+      materialBlock.normalMapScale = float(material.normalTexture.scale);
+      materialBlock.hasNormalMap = 1;
+    }
+  }
+  return materialBlocks;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "texture_streamer.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <vector>
+
+// CPU side of the interface blocks of forward.vs.glsl,
+// pbr_directional_light.fs.glsl and cull_draws.cs.glsl. Members are vec4
+// sized and aligned so that the std140 and std430 layouts are the same as the
+// C++ layout.
+
+// Vertex attribute locations, as declared in forward.vs.glsl
+const GLuint VERTEX_ATTRIB_POSITION_IDX = 0;
+const GLuint VERTEX_ATTRIB_NORMAL_IDX = 1;
+const GLuint VERTEX_ATTRIB_TEXCOORD0_IDX = 2;
+const GLuint VERTEX_ATTRIB_TANGENT_IDX = 3;
+// Index of the draw, an instanced attribute selected by the base instance
+const GLuint VERTEX_ATTRIB_DRAW_INDEX_IDX = 4;
+const GLuint VERTEX_ATTRIB_JOINTS0_IDX = 5; // Integer attribute
+const GLuint VERTEX_ATTRIB_WEIGHTS0_IDX = 6;
+
+// Binding points, as declared in the shaders
+const GLuint FRAME_BLOCK_BINDING = 0; // Uniform buffer
+const GLuint OBJECT_BLOCK_BINDING = 1; // Shader storage buffer
+const GLuint MATERIAL_BLOCK_BINDING = 2; // Shader storage buffer
+// Multi-draw indirect commands culled by cull_draws.cs.glsl
+const GLuint DRAW_COMMAND_BLOCK_BINDING = 3; // Shader storage buffer
+const GLuint MORPH_DELTA_BLOCK_BINDING = 4; // Shader storage buffer
+const GLuint MORPH_WEIGHT_BLOCK_BINDING = 5; // Shader storage buffer
+const GLuint JOINT_BLOCK_BINDING = 6; // Shader storage buffer
+
+// Texture units of the material textures, as declared in the shaders
+const GLuint BASE_COLOR_TEXTURE_UNIT = 0;
+const GLuint METALLIC_ROUGHNESS_TEXTURE_UNIT = 1;
+const GLuint EMISSIVE_TEXTURE_UNIT = 2;
+const GLuint OCCLUSION_TEXTURE_UNIT = 3;
+const GLuint NORMAL_TEXTURE_UNIT = 4;
+const GLuint MATERIAL_TEXTURE_UNIT_COUNT = 5;
+
+// Per frame data, std140 uniform block
+struct FrameBlock
+{
+  glm::mat4 viewMatrix;
+  glm::mat4 projMatrix;
+  glm::vec4 lightDirection; // View space, w unused
+  glm::vec4 lightIntensity; // w unused
+};
+
+// Per draw data, element of a std430 array indexed by the draw index
+struct ObjectBlock
+{
+  glm::mat4 modelMatrix;
+  glm::mat4 normalMatrix; // Inverse transpose of modelMatrix
+  uint32_t materialIdx; // In the material array
+  // Deltas of target t for vertex v (gl_VertexID) start at
+  // morphDeltaBase + (v * morphTargetCount + t) * 3 in the morph delta array:
+  // the base is offset by the base vertex of the draw, see MorphTargets
+  int32_t morphDeltaBase;
+  uint32_t morphTargetCount;
+  uint32_t morphWeightOffset; // In the morph weight array
+  // World space bounds of the draw, for culling, w unused. Empty (min > max)
+  // if unknown: never culled.
+  glm::vec4 boundsMin;
+  glm::vec4 boundsMax;
+  // First joint matrix of the skin of the draw in the joint matrix array, -1
+  // if not skinned
+  int32_t jointOffset;
+  uint32_t padding[3];
+};
+
+// Element of a std430 array indexed by material
+struct MaterialBlock
+{
+  glm::vec4 baseColorFactor;
+  glm::vec4 emissiveFactor; // w unused
+  float metallicFactor;
+  float roughnessFactor;
+  float occlusionStrength;
+  float normalMapScale;
+  int32_t hasNormalMap;
+  int32_t padding[3];
+};
+
+static_assert(sizeof(FrameBlock) == 160, "Unexpected FrameBlock layout");
+static_assert(sizeof(ObjectBlock) == 192, "Unexpected ObjectBlock layout");
+static_assert(sizeof(MaterialBlock) == 64, "Unexpected MaterialBlock layout");
+
+// Material blocks of model.materials, followed by the default material used
+// by primitives without material (see defaultMaterialIndex). A normal map is
+// only enabled once its texture is resident.
+std::vector<MaterialBlock> getMaterialBlocks(
+    const tinygltf::Model &model, const TextureStreamer &textureStreamer);
+
+inline uint32_t defaultMaterialIndex(const tinygltf::Model &model)
+{
+  return uint32_t(model.materials.size());
+}
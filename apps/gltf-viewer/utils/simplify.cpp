@@ -0,0 +1,274 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Sum of squared distances to planes, as a symmetric 4x4 matrix, weighted by
+// the area of the triangles of the planes
+struct Quadric
+{
+  double a2 = 0, ab = 0, ac = 0, ad = 0;
+  double b2 = 0, bc = 0, bd = 0;
+  double c2 = 0, cd = 0;
+  double d2 = 0;
+  double weight = 0;
+
+  void add(const Quadric &q)
+  {
+    a2 += q.a2;
+    ab += q.ab;
+    ac += q.ac;
+    ad += q.ad;
+    b2 += q.b2;
+    bc += q.bc;
+    bd += q.bd;
+    c2 += q.c2;
+    cd += q.cd;
+    d2 += q.d2;
+    weight += q.weight;
+  }
+
+  // Plane of unit normal n through point p
+  void addPlane(const glm::dvec3 &n, const glm::dvec3 &p, double w)
+  {
+    const auto d = -glm::dot(n, p);
+    a2 += w * n.x * n.x;
+    ab += w * n.x * n.y;
+    ac += w * n.x * n.z;
+    ad += w * n.x * d;
+    b2 += w * n.y * n.y;
+    bc += w * n.y * n.z;
+    bd += w * n.y * d;
+    c2 += w * n.z * n.z;
+    cd += w * n.z * d;
+    d2 += w * d * d;
+    weight += w;
+  }
+
+  // Mean squared distance of p to the planes
+  double error(const glm::dvec3 &p) const
+  {
+    const auto e = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z +
+                   2 * ad * p.x + b2 * p.y * p.y + 2 * bc * p.y * p.z +
+                   2 * bd * p.y + c2 * p.z * p.z + 2 * cd * p.z + d2;
+    return weight > 0 ? std::max(e, 0.) / weight : 0.;
+  }
+};
+
+struct Collapse
+{
+  uint32_t from;
+  uint32_t to;
+  double error;
+};
+} // namespace
+
+std::vector<uint32_t> simplifyTriangles(const glm::vec3 *positions,
+    size_t vertexCount, const uint32_t *indices, size_t indexCount,
+    size_t targetIndexCount, float &error)
+{
+  std::vector<uint32_t> result(indices, indices + indexCount / 3 * 3);
+  error = 0.f;
+
+  // Vertex quadrics, from the planes of their triangles
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < result.size(); i += 3) {
+    const glm::dvec3 p0 = positions[result[i]];
+    const glm::dvec3 p1 = positions[result[i + 1]];
+    const glm::dvec3 p2 = positions[result[i + 2]];
+    const auto normal = glm::cross(p1 - p0, p2 - p0);
+    const auto doubleArea = glm::length(normal);
+    if (doubleArea <= 0.) {
+      continue;
+    }
+    Quadric q;
+    q.addPlane(normal / doubleArea, p0, 0.5 * doubleArea);
+    for (int c = 0; c < 3; ++c) {
+      quadrics[result[i + c]].add(q);
+    }
+  }
+
+  // Border vertices, on edges of a single triangle, are locked. An edge is
+  // a border if its opposite half-edge is missing.
+  std::vector<uint8_t> locked(vertexCount, 0);
+  {
+    std::vector<uint64_t> halfEdges;
+    halfEdges.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int c = 0; c < 3; ++c) {
+        const uint64_t a = result[i + c];
+        const uint64_t b = result[i + (c + 1) % 3];
+        halfEdges.push_back((a << 32) | b);
+      }
+    }
+    std::sort(begin(halfEdges), end(halfEdges));
+    for (const auto halfEdge : halfEdges) {
+      const auto a = uint32_t(halfEdge >> 32);
+      const auto b = uint32_t(halfEdge);
+      const uint64_t opposite = (uint64_t(b) << 32) | a;
+      if (!std::binary_search(begin(halfEdges), end(halfEdges), opposite)) {
+        locked[a] = locked[b] = 1;
+      }
+    }
+  }
+
+  double maxError = 0.;
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<uint8_t> touched(vertexCount);
+  std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+  std::vector<uint32_t> vertexTriangles;
+  std::vector<Collapse> collapses;
+  // Passes of independent collapses, the cheapest first, until the target
+  while (result.size() > targetIndexCount) {
+    // Triangles of each vertex
+    std::fill(begin(triangleOffsets), end(triangleOffsets), 0);
+    for (const auto v : result) {
+      ++triangleOffsets[v + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+      triangleOffsets[v + 1] += triangleOffsets[v];
+    }
+    vertexTriangles.resize(result.size());
+    {
+      auto ends = triangleOffsets;
+      for (size_t i = 0; i < result.size(); ++i) {
+        vertexTriangles[ends[result[i]]++] = uint32_t(i / 3);
+      }
+    }
+
+    // Candidate collapses of the edges, in the cheapest direction
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int c = 0; c < 3; ++c) {
+        const auto a = result[i + c];
+        const auto b = result[i + (c + 1) % 3];
+        // Interior edges appear twice, once in each direction, and borders
+        // do not collapse
+        if (a > b) {
+          continue;
+        }
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+        const auto errorAB = locked[a] ? -1. : q.error(positions[b]);
+        const auto errorBA = locked[b] ? -1. : q.error(positions[a]);
+        if (errorAB >= 0. && (errorBA < 0. || errorAB <= errorBA)) {
+          collapses.push_back(Collapse{a, b, errorAB});
+        } else if (errorBA >= 0.) {
+          collapses.push_back(Collapse{b, a, errorBA});
+        }
+      }
+    }
+    if (collapses.empty()) {
+      break;
+    }
+    std::sort(begin(collapses), end(collapses),
+        [](const Collapse &lhs, const Collapse &rhs) {
+          return lhs.error < rhs.error;
+        });
+
+    // A collapse removes about two triangles
+    const auto maxCollapseCount = (result.size() - targetIndexCount) / 6 + 1;
+    size_t collapseCount = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+      remap[v] = uint32_t(v);
+    }
+    std::fill(begin(touched), end(touched), 0);
+    for (const auto &collapse : collapses) {
+      if (collapseCount >= maxCollapseCount) {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to]) {
+        continue;
+      }
+      // The triangles of from that remain must not flip
+      const glm::dvec3 target = positions[collapse.to];
+      bool flips = false;
+      for (auto t = triangleOffsets[collapse.from];
+           t < triangleOffsets[collapse.from + 1] && !flips; ++t) {
+        const auto *triangle = result.data() + 3 * vertexTriangles[t];
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+            triangle[2] == collapse.to) {
+          continue;
+        }
+        glm::dvec3 before[3];
+        glm::dvec3 after[3];
+        for (int c = 0; c < 3; ++c) {
+          before[c] = positions[triangle[c]];
+          after[c] = triangle[c] == collapse.from ? target : before[c];
+        }
+        const auto normalBefore =
+            glm::cross(before[1] - before[0], before[2] - before[0]);
+        const auto normalAfter =
+            glm::cross(after[1] - after[0], after[2] - after[0]);
+        flips = glm::dot(normalBefore, normalAfter) <=
+                0.25 * glm::length(normalBefore) * glm::length(normalAfter);
+      }
+      if (flips) {
+        continue;
+      }
+      // The neighbours of from do not move in this pass, so that the flip
+      // test above stays valid
+      for (auto t = triangleOffsets[collapse.from];
+           t < triangleOffsets[collapse.from + 1]; ++t) {
+        const auto *triangle = result.data() + 3 * vertexTriangles[t];
+        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+      }
+      touched[collapse.to] = 1;
+      remap[collapse.from] = collapse.to;
+      quadrics[collapse.to].add(quadrics[collapse.from]);
+      maxError = std::max(maxError, collapse.error);
+      ++collapseCount;
+    }
+    if (!collapseCount) {
+      break;
+    }
+
+    // Remove the triangles that became degenerate
+    size_t resultSize = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      const auto a = remap[result[i]];
+      const auto b = remap[result[i + 1]];
+      const auto c = remap[result[i + 2]];
+      if (a != b && b != c && c != a) {
+        result[resultSize++] = a;
+        result[resultSize++] = b;
+        result[resultSize++] = c;
+      }
+    }
+    result.resize(resultSize);
+  }
+
+  error = float(std::sqrt(maxError));
+  return result;
+}
+
+std::vector<MeshLod> buildLodChain(const glm::vec3 *positions,
+    size_t vertexCount, const std::vector<uint32_t> &indices,
+    size_t maxLodCount)
+{
+  // Coarser levels of small meshes would not save much
+  static const size_t minTriangleCount = 256;
+  std::vector<MeshLod> lods;
+  const auto *levelIndices = &indices;
+  float levelError = 0.f;
+  while (lods.size() < maxLodCount &&
+         levelIndices->size() / 3 >= 2 * minTriangleCount) {
+    // Each level simplifies the previous one, their errors add up
+    MeshLod lod;
+    float error;
+    lod.indices = simplifyTriangles(positions, vertexCount,
+        levelIndices->data(), levelIndices->size(),
+        levelIndices->size() / 6 * 3, error);
+    // Stop when borders and flips prevent simplification
+    if (lod.indices.size() > levelIndices->size() * 3 / 4) {
+      break;
+    }
+    levelError += error;
+    lod.error = levelError;
+    lods.push_back(std::move(lod));
+    levelIndices = &lods.back().indices;
+  }
+  return lods;
+}
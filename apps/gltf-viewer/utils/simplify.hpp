@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Simplify a triangle list by quadric edge collapses, down to about
+// targetIndexCount indices. A collapse moves a vertex onto a neighbour, so the
+// vertices are kept and only the indices change: the result can be drawn with
+// the vertex buffer of the mesh. Vertices on borders, which include attribute
+// seams since seam vertices are split, never move, and collapses flipping a
+// triangle are rejected, so the target may not be reached.
+// error is set to the largest distance of a collapse to the surface, in the
+// units of positions (from the quadrics, an estimate rather than a bound).
+std::vector<uint32_t> simplifyTriangles(const glm::vec3 *positions,
+    size_t vertexCount, const uint32_t *indices, size_t indexCount,
+    size_t targetIndexCount, float &error);
+
+// A simplified level of detail of a mesh
+struct MeshLod
+{
+  std::vector<uint32_t> indices;
+  float error = 0.f; // Relative to the full mesh, see simplifyTriangles
+};
+
+// Levels of detail of a triangle mesh, coarser and coarser, each with about
+// half the triangles of the previous one, not including the full mesh. Empty
+// for small meshes.
+std::vector<MeshLod> buildLodChain(const glm::vec3 *positions,
+    size_t vertexCount, const std::vector<uint32_t> &indices,
+    size_t maxLodCount);
@@ -0,0 +1,85 @@
+#include "stream_buffer.hpp"
+
+#include <algorithm>
+
+// Segment sizes are a multiple of this, which covers the offset alignment of
+// uniform and shader storage buffer bindings on all known implementations
+static const size_t SEGMENT_ALIGNMENT = 256;
+
+StreamBuffer::~StreamBuffer()
+{
+  for (auto &fence : m_SegmentFences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  if (m_BufferObject) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &m_BufferObject);
+  }
+}
+
+void *StreamBuffer::beginWrite(size_t size)
+{
+  m_nSegmentIdx = (m_nSegmentIdx + 1) % SEGMENT_COUNT;
+  if (size > m_nSegmentSize) {
+    // Grow by powers of two to reallocate rarely
+    auto segmentSize = std::max(m_nSegmentSize, SEGMENT_ALIGNMENT);
+    while (segmentSize < size) {
+      segmentSize *= 2;
+    }
+    reallocate(segmentSize);
+  } else {
+    waitSegment(m_nSegmentIdx);
+  }
+  return m_pMappedData + segmentOffset();
+}
+
+void StreamBuffer::endWrite()
+{
+  m_SegmentFences[m_nSegmentIdx] =
+      glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::bindRange(GLenum target, GLuint index, size_t size) const
+{
+  glBindBufferRange(target, index, m_BufferObject, GLintptr(segmentOffset()),
+      GLsizeiptr(std::max(size, size_t(1))));
+}
+
+void StreamBuffer::waitSegment(size_t segmentIdx)
+{
+  auto &fence = m_SegmentFences[segmentIdx];
+  if (fence) {
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) ==
+           GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(fence);
+    fence = 0;
+  }
+}
+
+void StreamBuffer::reallocate(size_t segmentSize)
+{
+  for (size_t segmentIdx = 0; segmentIdx < SEGMENT_COUNT; ++segmentIdx) {
+    waitSegment(segmentIdx);
+  }
+  if (m_BufferObject) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glDeleteBuffers(1, &m_BufferObject);
+  }
+
+  m_nSegmentSize = segmentSize;
+  const auto bufferSize = SEGMENT_COUNT * m_nSegmentSize;
+  const GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &m_BufferObject);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferObject);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, bufferSize, nullptr, flags);
+  m_pMappedData = (unsigned char *)glMapBufferRange(
+      GL_COPY_WRITE_BUFFER, 0, bufferSize, flags);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// A persistently mapped buffer object for data rewritten every frame. It is
+// split in segments used in turn by successive frames, each protected by a
+// fence, so that the CPU writes a segment while the GPU still reads the
+// previous ones without synchronizing.
+// A segment grows as needed, the buffer is then reallocated after waiting for
+// the GPU to be done with it.
+class StreamBuffer
+{
+public:
+  StreamBuffer() = default;
+
+  ~StreamBuffer();
+
+  // Non-copyable class:
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+  // Start writing the next segment: return a pointer to at least size bytes,
+  // blocking if the GPU still reads the segment
+  void *beginWrite(size_t size);
+
+  // Fence the segment written since beginWrite. To be called after the
+  // commands reading it have been issued.
+  void endWrite();
+
+  // Bind size bytes of the segment being written to an indexed target
+  // (GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER...)
+  void bindRange(GLenum target, GLuint index, size_t size) const;
+
+  GLuint bufferObject() const { return m_BufferObject; }
+
+  // Offset of the segment being written in the buffer object
+  size_t segmentOffset() const { return m_nSegmentIdx * m_nSegmentSize; }
+
+private:
+  void waitSegment(size_t segmentIdx);
+
+  void reallocate(size_t segmentSize);
+
+  static const size_t SEGMENT_COUNT = 3;
+
+  GLuint m_BufferObject = 0;
+  unsigned char *m_pMappedData = nullptr;
+  size_t m_nSegmentSize = 0;
+  GLsync m_SegmentFences[SEGMENT_COUNT] = {};
+  size_t m_nSegmentIdx = 0;
+};
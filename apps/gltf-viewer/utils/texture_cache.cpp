@@ -0,0 +1,113 @@
+#include "texture_cache.hpp"
+#include "hash.hpp"
+#include "mipmaps.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+static const char TEXTURE_CACHE_MAGIC[4] = {'G', 'V', 'T', 'C'};
+// To be incremented when the format or the content of entries changes
+static const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+struct TextureCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t component;
+  int32_t bits;
+  uint64_t pixelsSize;
+};
+
+TextureCache::TextureCache(fs::path directory) :
+    m_Directory(std::move(directory))
+{
+  try {
+    fs::create_directories(m_Directory);
+  } catch (const fs::filesystem_error &) {
+    // Entries will fail to be stored
+  }
+}
+
+uint64_t TextureCache::key(const unsigned char *bytes, size_t size, bool srgb)
+{
+  return hashBytes(bytes, size, srgb ? 0x5247ull : 0);
+}
+
+bool TextureCache::load(uint64_t key, CachedImage &image) const
+{
+  if (!image.file.open(entryPath(key))) {
+    return false;
+  }
+  TextureCacheHeader header;
+  if (image.file.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, image.file.data(), sizeof(header));
+  if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) ||
+      header.version != TEXTURE_CACHE_VERSION || header.width <= 0 ||
+      header.height <= 0 || header.component < 1 || header.component > 4 ||
+      (header.bits != 8 && header.bits != 16) ||
+      header.pixelsSize != mipChainSize(header.width, header.height,
+                               header.component, header.bits) ||
+      image.file.size() - sizeof(header) < header.pixelsSize) {
+    image.file.close();
+    return false;
+  }
+  image.width = header.width;
+  image.height = header.height;
+  image.component = header.component;
+  image.bits = header.bits;
+  image.pixels = ByteSpan{image.file.data() + sizeof(header), header.pixelsSize};
+  return true;
+}
+
+void TextureCache::store(uint64_t key, int width, int height, int component,
+    int bits, const std::vector<unsigned char> &pixels) const
+{
+  TextureCacheHeader header;
+  std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+  header.version = TEXTURE_CACHE_VERSION;
+  header.width = width;
+  header.height = height;
+  header.component = component;
+  header.bits = bits;
+  header.pixelsSize = pixels.size();
+
+  // Write a temporary file then rename it, so that a concurrent or
+  // interrupted run never sees a partial entry
+  const auto path = entryPath(key);
+  auto tmpPath = path;
+  tmpPath += ".tmp" + std::to_string(std::hash<std::thread::id>()(
+                          std::this_thread::get_id()));
+  bool written;
+  {
+    std::ofstream file(tmpPath.string(), std::ios::binary);
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)pixels.data(), pixels.size());
+    file.close();
+    written = bool(file);
+  }
+  try {
+    if (written) {
+      fs::rename(tmpPath, path);
+    } else {
+      fs::remove(tmpPath);
+    }
+  } catch (const fs::filesystem_error &) {
+  }
+}
+
+fs::path TextureCache::entryPath(uint64_t key) const
+{
+  std::stringstream ss;
+  ss << std::hex;
+  ss.width(16);
+  ss.fill('0');
+  ss << key;
+  return m_Directory / (ss.str() + ".tex");
+}
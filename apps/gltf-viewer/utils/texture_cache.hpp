@@ -0,0 +1,47 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gltf.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdint>
+
+// Decoded pixels of an image with its full mip chain (see generateMipmaps),
+// viewed in place in a mapped cache file
+struct CachedImage
+{
+  MappedFile file;
+  int width = 0;
+  int height = 0;
+  int component = 0;
+  int bits = 0;
+  ByteSpan pixels; // Levels, largest first, tightly packed
+};
+
+// Persistent cache of decoded images, so that images decoded by a previous
+// run are not decoded again. Entries are files of the cache directory named
+// after a hash of the encoded image bytes.
+// load and store can be called concurrently from several threads.
+class TextureCache
+{
+public:
+  // The directory is created if needed
+  explicit TextureCache(fs::path directory);
+
+  // Key of an encoded image. Mipmaps of sRGB images are computed differently,
+  // which is part of the key.
+  static uint64_t key(const unsigned char *bytes, size_t size, bool srgb);
+
+  // Map the entry of key. Return false if there is no valid entry.
+  bool load(uint64_t key, CachedImage &image) const;
+
+  // Write the entry of key: pixels holds the full mip chain of an image.
+  // Failures are not reported, the entry is just missing next time.
+  void store(uint64_t key, int width, int height, int component, int bits,
+      const std::vector<unsigned char> &pixels) const;
+
+private:
+  fs::path entryPath(uint64_t key) const;
+
+  fs::path m_Directory;
+};
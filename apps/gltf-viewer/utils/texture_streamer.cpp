@@ -0,0 +1,426 @@
+#include "texture_streamer.hpp"
+#include "ktx2.hpp"
+#include "mipmaps.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+// Offsets of transfers in the pixel buffer, enough for any row alignment
+static const size_t PIXEL_BUFFER_ALIGNMENT = 16;
+
+// Encoded bytes of an image loaded with deferred image decoding
+static ByteSpan encodedImage(
+    const tinygltf::Model &model, const GltfBuffers &buffers, int imageIdx)
+{
+  if (size_t(imageIdx) < buffers.encodedImages.size() &&
+      buffers.encodedImages[imageIdx].data) {
+    return buffers.encodedImages[imageIdx];
+  }
+  const auto &image = model.images[imageIdx];
+  if (image.as_is) {
+    return ByteSpan{image.image.data(), image.image.size()};
+  }
+  return ByteSpan{};
+}
+
+// The image of KHR_texture_basisu if we can use it, the fallback image
+// otherwise
+static int textureImage(
+    const tinygltf::Model &model, const GltfBuffers &buffers, int textureIdx)
+{
+  const auto &texture = model.textures[textureIdx];
+  const auto basisuIt = texture.extensions.find("KHR_texture_basisu");
+  if (basisuIt == end(texture.extensions) ||
+      !basisuIt->second.Get("source").IsInt()) {
+    return texture.source;
+  }
+  const auto source = basisuIt->second.Get("source").Get<int>();
+  Ktx2Image ktx2Image;
+  std::string err = "Invalid KHR_texture_basisu source";
+  if (source >= 0 && size_t(source) < model.images.size()) {
+    const auto bytes = encodedImage(model, buffers, source);
+    if (parseKtx2(bytes.data, bytes.size, ktx2Image, err)) {
+      return source;
+    }
+  }
+  std::cerr << "Warn: texture " << textureIdx << ": " << err
+            << (texture.source >= 0 ? ", using its fallback image" : "")
+            << std::endl;
+  return texture.source;
+}
+
+// Textures holding colors are sRGB encoded
+static std::vector<bool> getSrgbTextures(const tinygltf::Model &model)
+{
+  std::vector<bool> srgbTextures(model.textures.size(), false);
+  for (const auto &material : model.materials) {
+    for (const auto textureIdx :
+        {material.pbrMetallicRoughness.baseColorTexture.index,
+            material.emissiveTexture.index}) {
+      if (textureIdx >= 0 && size_t(textureIdx) < srgbTextures.size()) {
+        srgbTextures[textureIdx] = true;
+      }
+    }
+  }
+  return srgbTextures;
+}
+
+TextureStreamer::TextureStreamer(tinygltf::Model &model, GltfBuffers &buffers,
+    size_t frameByteBudget, const fs::path &cacheDirectory) :
+    m_Model(model),
+    m_ImageObjects(model.images.size(), 0),
+    m_ImageViews(model.images.size(), 0),
+    m_ImageFormats(model.images.size(), 0),
+    m_ImageTextures(model.images.size()),
+    m_TextureObjects(model.textures.size(), 0),
+    m_TextureSamplers(model.textures.size(), 0),
+    m_SrgbTextures(getSrgbTextures(model)),
+    m_ResidentTextures(model.textures.size(), false),
+    m_nSegmentSize(frameByteBudget)
+{
+  createSamplers();
+
+  std::vector<int> usedImages;
+  // Mipmaps of images used by both kinds of textures are filtered as sRGB
+  std::vector<bool> srgbImages(model.images.size(), false);
+  for (int textureIdx = 0; textureIdx < int(model.textures.size());
+       ++textureIdx) {
+    const auto imageIdx = textureImage(model, buffers, textureIdx);
+    if (imageIdx >= 0) {
+      if (m_ImageTextures[imageIdx].empty()) {
+        usedImages.push_back(imageIdx);
+      }
+      m_ImageTextures[imageIdx].push_back(textureIdx);
+      if (m_SrgbTextures[textureIdx]) {
+        srgbImages[imageIdx] = true;
+      }
+    }
+  }
+  if (!cacheDirectory.empty()) {
+    m_pCache = std::make_unique<TextureCache>(cacheDirectory);
+  }
+  m_pImageDecoder = std::make_unique<ImageDecoder>(
+      model, buffers, usedImages, srgbImages, m_pCache.get());
+
+  const auto pixelBufferSize = SEGMENT_COUNT * m_nSegmentSize;
+  const GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &m_PixelBuffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PixelBuffer);
+  glBufferStorage(GL_PIXEL_UNPACK_BUFFER, pixelBufferSize, nullptr, flags);
+  m_pMappedPixels = (unsigned char *)glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, 0, pixelBufferSize, flags);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+  // Wait for the workers before releasing what they write to
+  m_pImageDecoder.reset();
+
+  for (auto &fence : m_SegmentFences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PixelBuffer);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glDeleteBuffers(1, &m_PixelBuffer);
+  // Zeros are ignored
+  glDeleteTextures(GLsizei(m_ImageViews.size()), m_ImageViews.data());
+  glDeleteTextures(GLsizei(m_ImageObjects.size()), m_ImageObjects.data());
+  glDeleteSamplers(GLsizei(m_SamplerObjects.size()), m_SamplerObjects.data());
+}
+
+void TextureStreamer::createSamplers()
+{
+  tinygltf::Sampler defaultSampler;
+  defaultSampler.minFilter = GL_LINEAR;
+  defaultSampler.magFilter = GL_LINEAR;
+  defaultSampler.wrapS = GL_REPEAT;
+  defaultSampler.wrapT = GL_REPEAT;
+
+  // Sampler objects by (minFilter, magFilter, wrapS, wrapT)
+  std::map<std::array<GLint, 4>, GLuint> samplerObjects;
+  for (size_t textureIdx = 0; textureIdx < m_Model.textures.size();
+       ++textureIdx) {
+    const auto &texture = m_Model.textures[textureIdx];
+    const auto &sampler = texture.sampler >= 0
+                              ? m_Model.samplers[texture.sampler]
+                              : defaultSampler;
+    const std::array<GLint, 4> state = {
+        sampler.minFilter != -1 ? sampler.minFilter : GL_LINEAR,
+        sampler.magFilter != -1 ? sampler.magFilter : GL_LINEAR,
+        sampler.wrapS, sampler.wrapT};
+
+    auto &samplerObject = samplerObjects[state];
+    if (!samplerObject) {
+      glGenSamplers(1, &samplerObject);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_MIN_FILTER, state[0]);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_MAG_FILTER, state[1]);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_WRAP_S, state[2]);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_WRAP_T, state[3]);
+      m_SamplerObjects.push_back(samplerObject);
+    }
+    m_TextureSamplers[textureIdx] = samplerObject;
+  }
+}
+
+void TextureStreamer::update()
+{
+  pollDecodedImages(false);
+  if (m_ReadyImages.empty()) {
+    return;
+  }
+
+  // Wait until the GPU is done with the transfers issued SEGMENT_COUNT frames
+  // ago from this segment, which should almost never block
+  auto &fence = m_SegmentFences[m_nSegmentIdx];
+  if (fence) {
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) ==
+           GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(fence);
+    fence = 0;
+  }
+
+  // Rows are tightly packed
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PixelBuffer);
+  size_t segmentOffset = 0;
+  while (!m_ReadyImages.empty() && uploadRows(segmentOffset)) {
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_nSegmentIdx = (m_nSegmentIdx + 1) % SEGMENT_COUNT;
+}
+
+void TextureStreamer::finish()
+{
+  while (!finished()) {
+    if (m_ReadyImages.empty()) {
+      pollDecodedImages(true);
+    }
+    update();
+  }
+}
+
+void TextureStreamer::pollDecodedImages(bool wait)
+{
+  if (!m_pImageDecoder) {
+    return;
+  }
+  for (int imageIdx;
+       (imageIdx = wait ? m_pImageDecoder->waitNext()
+                        : m_pImageDecoder->tryNext()) >= 0;) {
+    wait = false;
+    ReadyImage readyImage;
+    if (allocateTextures(imageIdx, readyImage)) {
+      m_ReadyImages.emplace_back(std::move(readyImage));
+    }
+  }
+  if (m_pImageDecoder->finished()) {
+    m_pImageDecoder.reset();
+  }
+}
+
+bool TextureStreamer::allocateTextures(int imageIdx, ReadyImage &readyImage)
+{
+  const auto &image = m_Model.images[imageIdx];
+  const auto isCached =
+      m_pImageDecoder->takeCachedImage(imageIdx, readyImage.cachedImage);
+  if ((!isCached && image.image.empty()) || image.width <= 0 ||
+      image.height <= 0) {
+    return false; // Not loaded or not decoded
+  }
+  readyImage.imageIdx = imageIdx;
+  const auto &textures = m_ImageTextures[imageIdx];
+
+  if (image.as_is) {
+    // A KTX2 image, already validated by ImageDecoder
+    Ktx2Image ktx2Image;
+    std::string err;
+    if (!parseKtx2(image.image.data(), image.image.size(), ktx2Image, err)) {
+      return false;
+    }
+    readyImage.compressed = true;
+    for (size_t level = 0; level < ktx2Image.levels.size(); ++level) {
+      UploadLevel uploadLevel;
+      uploadLevel.data = ktx2Image.levels[level].data;
+      uploadLevel.width = std::max(1, image.width >> level);
+      uploadLevel.height = std::max(1, image.height >> level);
+      uploadLevel.rowSize =
+          size_t((uploadLevel.width + 3) / 4) * ktx2Image.format.blockSize;
+      uploadLevel.rowCount = size_t((uploadLevel.height + 3) / 4);
+      uploadLevel.rowHeight = 4;
+      readyImage.levels.push_back(uploadLevel);
+    }
+    const auto srgbFormat = ktx2Image.format.srgbFormat
+                                ? ktx2Image.format.srgbFormat
+                                : ktx2Image.format.linearFormat;
+    createImageTexture(imageIdx, GLsizei(readyImage.levels.size()),
+        ktx2Image.format.linearFormat, srgbFormat);
+    return true;
+  }
+
+  const auto is16Bits = image.bits == 16;
+  const auto levelCount = mipLevelCount(image.width, image.height);
+  auto *levelData = isCached ? readyImage.cachedImage.pixels.data
+                             : image.image.data();
+  for (int level = 0; level < levelCount; ++level) {
+    UploadLevel uploadLevel;
+    uploadLevel.data = levelData;
+    uploadLevel.width = std::max(1, image.width >> level);
+    uploadLevel.height = std::max(1, image.height >> level);
+    uploadLevel.rowSize =
+        size_t(uploadLevel.width) * image.component * (is16Bits ? 2 : 1);
+    uploadLevel.rowCount = size_t(uploadLevel.height);
+    readyImage.levels.push_back(uploadLevel);
+    levelData += uploadLevel.rowSize * uploadLevel.rowCount;
+  }
+  readyImage.type = is16Bits ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+
+  // There is no 16 bits sRGB format: 16 bits colors are converted to 8 bits
+  // sRGB by the transfer, also when the image is viewed as linear. There is no
+  // core sRGB format with less than three components either, these are kept
+  // linear.
+  const auto usedAsSrgb = std::any_of(begin(textures), end(textures),
+      [&](int textureIdx) { return m_SrgbTextures[textureIdx]; });
+  const auto keep16Bits = is16Bits && !usedAsSrgb;
+  GLenum linearFormat, srgbFormat;
+  switch (image.component) {
+  case 1:
+    readyImage.format = GL_RED;
+    linearFormat = srgbFormat = is16Bits ? GL_R16 : GL_R8;
+    break;
+  case 2:
+    readyImage.format = GL_RG;
+    linearFormat = srgbFormat = is16Bits ? GL_RG16 : GL_RG8;
+    break;
+  case 3:
+    readyImage.format = GL_RGB;
+    linearFormat = keep16Bits ? GL_RGB16 : GL_RGB8;
+    srgbFormat = GL_SRGB8;
+    break;
+  default:
+    readyImage.format = GL_RGBA;
+    linearFormat = keep16Bits ? GL_RGBA16 : GL_RGBA8;
+    srgbFormat = GL_SRGB8_ALPHA8;
+    break;
+  }
+  createImageTexture(imageIdx, levelCount, linearFormat, srgbFormat);
+
+  // Grey and grey + alpha images
+  if (image.component <= 2) {
+    const GLint swizzle[] = {
+        GL_RED, GL_RED, GL_RED, image.component == 1 ? GL_ONE : GL_GREEN};
+    glBindTexture(GL_TEXTURE_2D, m_ImageObjects[imageIdx]);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  return true;
+}
+
+void TextureStreamer::createImageTexture(
+    int imageIdx, GLsizei levelCount, GLenum linearFormat, GLenum srgbFormat)
+{
+  const auto &image = m_Model.images[imageIdx];
+  const auto &textures = m_ImageTextures[imageIdx];
+  const auto usedAsSrgb = std::any_of(begin(textures), end(textures),
+      [&](int textureIdx) { return m_SrgbTextures[textureIdx]; });
+  const auto usedAsLinear = std::any_of(begin(textures), end(textures),
+      [&](int textureIdx) { return !m_SrgbTextures[textureIdx]; });
+
+  auto &imageObject = m_ImageObjects[imageIdx];
+  const auto storageFormat = usedAsSrgb ? srgbFormat : linearFormat;
+  glGenTextures(1, &imageObject);
+  glBindTexture(GL_TEXTURE_2D, imageObject);
+  glTexStorage2D(
+      GL_TEXTURE_2D, levelCount, storageFormat, image.width, image.height);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  m_ImageFormats[imageIdx] = storageFormat;
+
+  auto &imageView = m_ImageViews[imageIdx];
+  if (usedAsSrgb && usedAsLinear && srgbFormat != linearFormat) {
+    glGenTextures(1, &imageView);
+    glTextureView(imageView, GL_TEXTURE_2D, imageObject, linearFormat, 0,
+        GLuint(levelCount), 0, 1);
+  }
+  for (const auto textureIdx : textures) {
+    m_TextureObjects[textureIdx] =
+        imageView && !m_SrgbTextures[textureIdx] ? imageView : imageObject;
+  }
+}
+
+bool TextureStreamer::uploadRows(size_t &segmentOffset)
+{
+  auto &readyImage = m_ReadyImages.front();
+  const auto &level = readyImage.levels[readyImage.levelIdx];
+  const auto remainingRowCount = level.rowCount - readyImage.uploadedRowCount;
+
+  const auto availableRowCount =
+      (m_nSegmentSize - std::min(segmentOffset, m_nSegmentSize)) /
+      level.rowSize;
+  auto rowCount = std::min(remainingRowCount, availableRowCount);
+  const auto *rows = level.data + readyImage.uploadedRowCount * level.rowSize;
+  const GLvoid *pixels = nullptr;
+  if (rowCount > 0) {
+    const auto bufferOffset = m_nSegmentIdx * m_nSegmentSize + segmentOffset;
+    std::memcpy(m_pMappedPixels + bufferOffset, rows, rowCount * level.rowSize);
+    pixels = (const GLvoid *)bufferOffset; // In the bound pixel buffer
+    segmentOffset += (rowCount * level.rowSize + PIXEL_BUFFER_ALIGNMENT - 1) /
+                     PIXEL_BUFFER_ALIGNMENT * PIXEL_BUFFER_ALIGNMENT;
+  } else if (segmentOffset == 0) {
+    // A single row is larger than the budget: transfer it directly
+    rowCount = 1;
+    pixels = rows;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    segmentOffset = m_nSegmentSize;
+  } else {
+    return false;
+  }
+
+  const auto levelIdx = GLint(readyImage.levelIdx);
+  const auto y = GLint(readyImage.uploadedRowCount) * level.rowHeight;
+  const auto height =
+      std::min(GLsizei(rowCount) * level.rowHeight, level.height - y);
+  glBindTexture(GL_TEXTURE_2D, m_ImageObjects[readyImage.imageIdx]);
+  if (readyImage.compressed) {
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, levelIdx, 0, y, level.width,
+        height, m_ImageFormats[readyImage.imageIdx],
+        GLsizei(rowCount * level.rowSize), pixels);
+  } else {
+    glTexSubImage2D(GL_TEXTURE_2D, levelIdx, 0, y, level.width, height,
+        readyImage.format, readyImage.type, pixels);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PixelBuffer);
+
+  readyImage.uploadedRowCount += rowCount;
+  if (readyImage.uploadedRowCount == level.rowCount) {
+    readyImage.uploadedRowCount = 0;
+    if (++readyImage.levelIdx == readyImage.levels.size()) {
+      makeResident(readyImage);
+      m_ReadyImages.pop_front();
+    }
+  }
+  return true;
+}
+
+void TextureStreamer::makeResident(const ReadyImage &readyImage)
+{
+  for (const auto textureIdx : m_ImageTextures[readyImage.imageIdx]) {
+    m_ResidentTextures[textureIdx] = true;
+    ++m_nResidentTextureCount;
+  }
+
+  // Pixels are in the texture now, the cache entry is released with
+  // readyImage
+  std::vector<unsigned char>().swap(m_Model.images[readyImage.imageIdx].image);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "gltf.hpp"
+#include "image_decoder.hpp"
+#include "texture_cache.hpp"
+
+#include <deque>
+#include <glad/glad.h>
+#include <memory>
+#include <tiny_gltf.h>
+#include <vector>
+
+// Create the texture and sampler objects of a model, and fill textures
+// incrementally, as the images get decoded, so that rendering can start before
+// textures are resident.
+// Each image is uploaded once, to a texture shared by all the glTF textures
+// using it. Sampler state is in sampler objects shared by all the glTF
+// textures with the same filters and wrap modes.
+// Textures have immutable storage with a full mip chain, computed by the
+// ImageDecoder. Base color and emissive textures are sRGB, the others linear:
+// an image used both ways gets a linear texture view of its sRGB storage.
+// KTX2 images of KHR_texture_basisu in a BCn or ETC2 format are used in place
+// of the fallback image of a texture, and uploaded without decoding.
+// Pixels are copied to a persistently mapped pixel buffer object, split in
+// several segments used in turn by successive frames, and transferred to
+// textures from there. At most frameByteBudget bytes are transferred per
+// frame.
+class TextureStreamer
+{
+public:
+  // Image decoding starts right away. model and buffers must outlive the
+  // streamer. Decoded images are stored in a TextureCache in cacheDirectory,
+  // unless it is empty.
+  TextureStreamer(tinygltf::Model &model, GltfBuffers &buffers,
+      size_t frameByteBudget, const fs::path &cacheDirectory);
+
+  ~TextureStreamer();
+
+  // Non-copyable class:
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+  // Transfer at most frameByteBudget bytes of decoded pixels. To be called
+  // once per frame.
+  void update();
+
+  // Transfer everything, waiting for the images that are still being decoded
+  void finish();
+
+  // Return the texture object of model.textures[textureIdx] if all its pixels
+  // have been transferred, 0 otherwise
+  GLuint textureObject(int textureIdx) const
+  {
+    return m_ResidentTextures[textureIdx] ? m_TextureObjects[textureIdx] : 0;
+  }
+
+  // Sampler object to bind with textureObject(textureIdx)
+  GLuint samplerObject(int textureIdx) const
+  {
+    return m_TextureSamplers[textureIdx];
+  }
+
+  size_t textureCount() const { return m_TextureObjects.size(); }
+
+  size_t residentTextureCount() const { return m_nResidentTextureCount; }
+
+  // True when there is nothing left to transfer
+  bool finished() const { return !m_pImageDecoder && m_ReadyImages.empty(); }
+
+private:
+  // Rows of a mip level to transfer. For compressed images, a row is a row of
+  // 4x4 blocks.
+  struct UploadLevel
+  {
+    const unsigned char *data = nullptr;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    size_t rowSize = 0;
+    size_t rowCount = 0;
+    GLsizei rowHeight = 1; // In pixels
+  };
+
+  // A decoded image waiting for its textures to be filled
+  struct ReadyImage
+  {
+    int imageIdx = -1;
+    bool compressed = false;
+    GLenum format = 0; // Pixel format and type if not compressed
+    GLenum type = 0;
+    std::vector<UploadLevel> levels;
+    size_t levelIdx = 0; // Next level to transfer
+    size_t uploadedRowCount = 0; // In levels[levelIdx]
+    CachedImage cachedImage; // Holds the pixels if loaded from the cache
+  };
+
+  void createSamplers();
+
+  void pollDecodedImages(bool wait);
+
+  // Allocate the storage of the textures using a decoded image
+  bool allocateTextures(int imageIdx, ReadyImage &readyImage);
+
+  // Create the storage of an image with the format matching its use, and a
+  // view if it is used in both color spaces
+  void createImageTexture(
+      int imageIdx, GLsizei levelCount, GLenum linearFormat, GLenum srgbFormat);
+
+  // Transfer the next rows of m_ReadyImages.front() from the current pixel
+  // buffer segment. Return false if the segment is full.
+  bool uploadRows(size_t &segmentOffset);
+
+  void makeResident(const ReadyImage &readyImage);
+
+  static const size_t SEGMENT_COUNT = 3;
+
+  tinygltf::Model &m_Model;
+  std::unique_ptr<TextureCache> m_pCache;
+  std::unique_ptr<ImageDecoder> m_pImageDecoder;
+
+  // Indexed like model.images
+  std::vector<GLuint> m_ImageObjects; // Texture holding the storage
+  std::vector<GLuint> m_ImageViews; // Linear view of sRGB storage, if needed
+  std::vector<GLenum> m_ImageFormats; // Internal format of the storage
+  std::vector<std::vector<int>> m_ImageTextures; // textures using each image
+
+  // Indexed like model.textures
+  std::vector<GLuint> m_TextureObjects; // Storage or view of the image
+  std::vector<GLuint> m_TextureSamplers;
+  std::vector<bool> m_SrgbTextures;
+  std::vector<bool> m_ResidentTextures;
+  size_t m_nResidentTextureCount = 0;
+
+  std::vector<GLuint> m_SamplerObjects; // Unique samplers
+
+  std::deque<ReadyImage> m_ReadyImages; // Decoded, not fully transferred
+
+  GLuint m_PixelBuffer = 0;
+  unsigned char *m_pMappedPixels = nullptr;
+  size_t m_nSegmentSize = 0;
+  GLsync m_SegmentFences[SEGMENT_COUNT] = {};
+  size_t m_nSegmentIdx = 0;
+};
@@ -0,0 +1,53 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_Threads.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_bStopping = true;
+  }
+  m_TaskAvailable.notify_all();
+  for (auto &thread : m_Threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Tasks.emplace_back(std::move(task));
+  }
+  m_TaskAvailable.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_TaskAvailable.wait(
+          lock, [this]() { return m_bStopping || !m_Tasks.empty(); });
+      // Remaining tasks are still executed when stopping
+      if (m_Tasks.empty()) {
+        return;
+      }
+      task = std::move(m_Tasks.front());
+      m_Tasks.pop_front();
+    }
+    task();
+  }
+}
\ No newline at end of file
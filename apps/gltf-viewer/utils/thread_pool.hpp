@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads executing tasks in FIFO order.
+// The destructor waits for the tasks already pushed to complete.
+class ThreadPool
+{
+public:
+  // 0 means one thread per hardware thread
+  explicit ThreadPool(size_t threadCount = 0);
+
+  ~ThreadPool();
+
+  // Non-copyable class:
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void push(std::function<void()> task);
+
+  size_t threadCount() const { return m_Threads.size(); }
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> m_Threads;
+  std::deque<std::function<void()>> m_Tasks;
+  std::mutex m_Mutex;
+  std::condition_variable m_TaskAvailable;
+  bool m_bStopping = false;
+};
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "vertex_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// Size of the cache modelled by the scores, larger than actual caches so that
+// the order stays good for any of them
+const size_t SCORED_CACHE_SIZE = 32;
+
+// Score of a vertex from its position in the cache (-1 if not in it) and its
+// triangles left to emit, with the constants of Forsyth
+float vertexScore(int cachePosition, uint32_t remainingTriangleCount)
+{
+  if (!remainingTriangleCount) {
+    return -1.f;
+  }
+  float score = 0.f;
+  if (cachePosition >= 0) {
+    // The vertices of the last triangle get a fixed score, to not favour
+    // triangles sharing an edge with it over the others
+    score = cachePosition < 3
+                ? 0.75f
+                : std::pow(1.f - float(cachePosition - 3) /
+                                     float(SCORED_CACHE_SIZE - 3),
+                      1.5f);
+  }
+  // Vertices with few triangles left are finished first
+  return score + 2.f / std::sqrt(float(remainingTriangleCount));
+}
+
+// A run of consecutive triangles, for overdraw optimization
+struct Cluster
+{
+  size_t firstTriangle;
+  size_t triangleCount;
+  float sortKey;
+};
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t indexCount,
+    size_t vertexCount, size_t cacheSize)
+{
+  VertexCacheStats stats;
+  stats.triangleCount = indexCount / 3;
+  // A vertex is in the cache if it missed less than cacheSize misses ago
+  std::vector<size_t> missTimes(vertexCount, 0);
+  std::vector<uint8_t> referenced(vertexCount, 0);
+  auto missTime = cacheSize + 1;
+  for (size_t i = 0; i < stats.triangleCount * 3; ++i) {
+    const auto vertex = indices[i];
+    if (missTime - missTimes[vertex] > cacheSize) {
+      missTimes[vertex] = missTime++;
+      ++stats.transformedVertexCount;
+    }
+    if (!referenced[vertex]) {
+      referenced[vertex] = 1;
+      ++stats.vertexCount;
+    }
+  }
+  return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount)
+{
+  const auto triangleCount = indices.size() / 3;
+  if (!triangleCount) {
+    return;
+  }
+
+  // Triangles of each vertex, those not emitted yet first
+  std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    ++triangleOffsets[indices[i] + 1];
+  }
+  for (size_t v = 0; v < vertexCount; ++v) {
+    triangleOffsets[v + 1] += triangleOffsets[v];
+  }
+  std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+  std::vector<uint32_t> remainingTriangleCounts(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    const auto v = indices[i];
+    vertexTriangles[triangleOffsets[v] + remainingTriangleCounts[v]++] =
+        uint32_t(i / 3);
+  }
+
+  std::vector<int> cachePositions(vertexCount, -1);
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    vertexScores[v] = vertexScore(-1, remainingTriangleCounts[v]);
+  }
+  std::vector<float> triangleScores(triangleCount, 0.f);
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    triangleScores[i / 3] += vertexScores[indices[i]];
+  }
+
+  std::vector<uint8_t> emitted(triangleCount, 0);
+  std::vector<uint32_t> result;
+  result.reserve(triangleCount * 3);
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> newCache;
+  // Triangles before it are all emitted, for dead ends
+  size_t nextTriangle = 0;
+  auto bestTriangle = size_t(std::max_element(begin(triangleScores),
+                                  end(triangleScores)) -
+                              begin(triangleScores));
+  while (bestTriangle < triangleCount) {
+    const uint32_t triangle[3] = {indices[3 * bestTriangle],
+        indices[3 * bestTriangle + 1], indices[3 * bestTriangle + 2]};
+    emitted[bestTriangle] = 1;
+    result.insert(end(result), triangle, triangle + 3);
+
+    // The vertices of the triangle move to the front of the cache
+    newCache.clear();
+    for (const auto v : triangle) {
+      auto *triangles = vertexTriangles.data() + triangleOffsets[v];
+      auto &remainingTriangleCount = remainingTriangleCounts[v];
+      const auto it =
+          std::find(triangles, triangles + remainingTriangleCount, bestTriangle);
+      std::swap(*it, triangles[--remainingTriangleCount]);
+      if (std::find(begin(newCache), end(newCache), v) == end(newCache)) {
+        newCache.push_back(v);
+      }
+    }
+    for (const auto v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        newCache.push_back(v);
+      }
+    }
+    for (size_t i = SCORED_CACHE_SIZE; i < newCache.size(); ++i) {
+      cachePositions[newCache[i]] = -1;
+    }
+
+    // Update the scores of the vertices that moved, and of their triangles
+    bestTriangle = triangleCount;
+    float bestScore = -1.f;
+    for (size_t i = 0; i < newCache.size(); ++i) {
+      const auto v = newCache[i];
+      if (i < SCORED_CACHE_SIZE) {
+        cachePositions[v] = int(i);
+      }
+      const auto score = vertexScore(cachePositions[v], remainingTriangleCounts[v]);
+      const auto scoreDelta = score - vertexScores[v];
+      vertexScores[v] = score;
+      const auto *triangles = vertexTriangles.data() + triangleOffsets[v];
+      for (uint32_t t = 0; t < remainingTriangleCounts[v]; ++t) {
+        triangleScores[triangles[t]] += scoreDelta;
+      }
+    }
+    // The next triangle is the best one using a cached vertex
+    for (size_t i = 0; i < newCache.size() && i < SCORED_CACHE_SIZE; ++i) {
+      const auto v = newCache[i];
+      const auto *triangles = vertexTriangles.data() + triangleOffsets[v];
+      for (uint32_t t = 0; t < remainingTriangleCounts[v]; ++t) {
+        if (triangleScores[triangles[t]] > bestScore) {
+          bestScore = triangleScores[triangles[t]];
+          bestTriangle = triangles[t];
+        }
+      }
+    }
+    if (newCache.size() > SCORED_CACHE_SIZE) {
+      newCache.resize(SCORED_CACHE_SIZE);
+    }
+    std::swap(cache, newCache);
+
+    // Or else the next one not emitted, in the input order
+    if (bestTriangle == triangleCount) {
+      while (nextTriangle < triangleCount && emitted[nextTriangle]) {
+        ++nextTriangle;
+      }
+      bestTriangle = nextTriangle;
+    }
+  }
+  indices = std::move(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+    const glm::vec3 *positions, size_t vertexCount, float maxAcmrRatio)
+{
+  // Clusters of less triangles cost too many cache misses at their boundaries
+  static const size_t minClusterTriangleCount = 128;
+  const auto triangleCount = indices.size() / 3;
+  if (triangleCount < 2 * minClusterTriangleCount) {
+    return;
+  }
+
+  // Clusters start where the simulated cache misses most vertices of a
+  // triangle: the order of the cache optimization restarts there anyway
+  std::vector<Cluster> clusters;
+  {
+    std::vector<size_t> missTimes(vertexCount, 0);
+    auto missTime = VERTEX_CACHE_SIZE + 1;
+    for (size_t t = 0; t < triangleCount; ++t) {
+      int missCount = 0;
+      for (int c = 0; c < 3; ++c) {
+        const auto vertex = indices[3 * t + c];
+        if (missTime - missTimes[vertex] > VERTEX_CACHE_SIZE) {
+          missTimes[vertex] = missTime++;
+          ++missCount;
+        }
+      }
+      if (clusters.empty() ||
+          (missCount >= 2 &&
+              clusters.back().triangleCount >= minClusterTriangleCount)) {
+        clusters.push_back(Cluster{t, 0, 0.f});
+      }
+      ++clusters.back().triangleCount;
+    }
+  }
+  if (clusters.size() < 2) {
+    return;
+  }
+
+  // Clusters facing away from the center of the mesh are drawn first
+  glm::dvec3 meshCenter(0.);
+  double meshArea = 0.;
+  std::vector<glm::dvec3> clusterCenters(clusters.size(), glm::dvec3(0.));
+  std::vector<glm::dvec3> clusterNormals(clusters.size(), glm::dvec3(0.));
+  for (size_t clusterIdx = 0; clusterIdx < clusters.size(); ++clusterIdx) {
+    const auto &cluster = clusters[clusterIdx];
+    double clusterArea = 0.;
+    for (auto t = cluster.firstTriangle;
+         t < cluster.firstTriangle + cluster.triangleCount; ++t) {
+      const glm::dvec3 p0 = positions[indices[3 * t]];
+      const glm::dvec3 p1 = positions[indices[3 * t + 1]];
+      const glm::dvec3 p2 = positions[indices[3 * t + 2]];
+      // Area weighted
+      const auto normal = glm::cross(p1 - p0, p2 - p0);
+      const auto area = glm::length(normal);
+      clusterCenters[clusterIdx] += (p0 + p1 + p2) * (area / 3.);
+      clusterNormals[clusterIdx] += normal;
+      clusterArea += area;
+    }
+    meshCenter += clusterCenters[clusterIdx];
+    meshArea += clusterArea;
+    if (clusterArea > 0.) {
+      clusterCenters[clusterIdx] /= clusterArea;
+    }
+  }
+  if (meshArea > 0.) {
+    meshCenter /= meshArea;
+  }
+  for (size_t clusterIdx = 0; clusterIdx < clusters.size(); ++clusterIdx) {
+    const auto normalLength = glm::length(clusterNormals[clusterIdx]);
+    clusters[clusterIdx].sortKey =
+        normalLength > 0.
+            ? float(glm::dot(clusterCenters[clusterIdx] - meshCenter,
+                        clusterNormals[clusterIdx]) /
+                    normalLength)
+            : 0.f;
+  }
+  std::stable_sort(begin(clusters), end(clusters),
+      [](const Cluster &lhs, const Cluster &rhs) {
+        return lhs.sortKey > rhs.sortKey;
+      });
+
+  std::vector<uint32_t> result;
+  result.reserve(triangleCount * 3);
+  for (const auto &cluster : clusters) {
+    result.insert(end(result), begin(indices) + 3 * cluster.firstTriangle,
+        begin(indices) + 3 * (cluster.firstTriangle + cluster.triangleCount));
+  }
+  const auto acmr =
+      analyzeVertexCache(indices.data(), indices.size(), vertexCount).acmr();
+  const auto resultAcmr =
+      analyzeVertexCache(result.data(), result.size(), vertexCount).acmr();
+  if (resultAcmr <= acmr * maxAcmrRatio) {
+    indices = std::move(result);
+  }
+}
+
+std::vector<uint32_t> optimizeVertexFetch(
+    std::vector<uint32_t> &indices, size_t vertexCount)
+{
+  const auto unused = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(vertexCount, unused);
+  uint32_t nextVertex = 0;
+  for (auto &index : indices) {
+    if (remap[index] == unused) {
+      remap[index] = nextVertex++;
+    }
+    index = remap[index];
+  }
+  for (auto &newVertex : remap) {
+    if (newVertex == unused) {
+      newVertex = nextVertex++;
+    }
+  }
+  return remap;
+}
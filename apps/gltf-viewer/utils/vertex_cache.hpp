@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Post-transform vertex cache efficiency of a triangle list, simulated with a
+// FIFO cache. Counts of several meshes can be added up.
+struct VertexCacheStats
+{
+  size_t triangleCount = 0;
+  size_t vertexCount = 0; // Referenced by the triangles
+  size_t transformedVertexCount = 0; // Cache misses
+
+  // Average cache miss ratio: transformed vertices per triangle, from 0.5 on
+  // regular grids to 3
+  float acmr() const
+  {
+    return triangleCount ? float(transformedVertexCount) / triangleCount : 0.f;
+  }
+
+  // Average transformed vertex ratio: transformed vertices per vertex, 1 at
+  // best
+  float atvr() const
+  {
+    return vertexCount ? float(transformedVertexCount) / vertexCount : 0.f;
+  }
+
+  VertexCacheStats &operator+=(const VertexCacheStats &stats)
+  {
+    triangleCount += stats.triangleCount;
+    vertexCount += stats.vertexCount;
+    transformedVertexCount += stats.transformedVertexCount;
+    return *this;
+  }
+};
+
+// Cache size of the simulation, a common size for current GPUs
+const size_t VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t indexCount,
+    size_t vertexCount, size_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorder the triangles of a triangle list for vertex cache locality, with the
+// algorithm of Tom Forsyth ("Linear-Speed Vertex Cache Optimisation"), which
+// does not depend on the exact cache size
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+// Reorder clusters of triangles of a list already optimized for the vertex
+// cache, so that clusters facing outwards, which tend to occlude the others,
+// come first (after Sander et al., "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"). The order is kept if the ACMR grows by more
+// than maxAcmrRatio.
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+    const glm::vec3 *positions, size_t vertexCount, float maxAcmrRatio = 1.05f);
+
+// Renumber vertices in the order of their first use by indices, which are
+// rewritten, for vertex fetch locality. Unused vertices come last. Return the
+// new index of each vertex, to reorder vertex data.
+std::vector<uint32_t> optimizeVertexFetch(
+    std::vector<uint32_t> &indices, size_t vertexCount);